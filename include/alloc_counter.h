@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+
+/// number of times the global `operator new` has been called so far
+/// (replaced in alloc_counter.cpp); compare two readings to check that
+/// a loop doesn't touch the heap
+size_t heap_allocations() noexcept;
@@ -0,0 +1,101 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "output.h"
+
+struct z_stream_s;
+
+/// writes rows as BGZF: a series of independent gzip members of at most
+/// 64 KiB each (marked with the "BC" extra field, and ending with the
+/// standard empty block), so the file is still a plain .gz to `gzip -d`
+/// and `fread`, but can also be decompressed in parallel or from the
+/// middle
+///
+/// blocks end on row boundaries wherever a row fits, and are compressed
+/// on `threads` threads while the calling thread keeps filling the next
+/// ones. `finish` writes the end-of-file block and then `index_path`
+/// (unless it's empty), a TSV with one line per block: its compressed
+/// and uncompressed offsets, the rows that start in it, and the range
+/// of their dates
+class BgzfWriter final : public RowWriter {
+  public:
+    BgzfWriter(OutputSink& sink, std::string index_path, int level,
+               size_t threads);
+    ~BgzfWriter() override;
+
+    BgzfWriter(const BgzfWriter&)            = delete;
+    BgzfWriter& operator=(const BgzfWriter&) = delete;
+
+    void header() override;
+    void row(const LogRecord& rec, std::string_view url) override;
+    /// appends `bytes` (a header, say) without counting it as rows
+    void text(std::string_view bytes);
+    /// appends one already serialized row, newline included; `date` is
+    /// any text that sorts in time order ("YYYY-MM-DD HH:MM:SS")
+    void line(std::string_view bytes, std::string_view date);
+    /// seals the current block and waits for every block to be written;
+    /// more rows can follow, in a new block
+    void flush() override;
+    /// flushes, then writes the end-of-file block and the index
+    void finish() override;
+
+  private:
+    struct Block {
+        // defined out of line: the implicit ones are too big for -Winline
+        Block();
+        Block(Block&&) noexcept;
+        Block& operator=(Block&&) noexcept;
+        ~Block();
+
+        std::string raw        {};
+        std::string compressed {};
+        bool done              {false};
+        // rows starting in this block
+        uint64_t first_row     {0};
+        uint64_t rows          {0};
+        std::string min_date   {};
+        std::string max_date   {};
+    };
+
+    void append(const char* data, size_t size);
+    void seal();
+    void write_done_blocks(std::unique_lock<std::mutex>& lock);
+    void compress_blocks(z_stream_s& zs);
+
+    OutputSink* sink_                 {nullptr};
+    std::string index_path_           {};
+    int level_                        {6};
+    size_t max_in_flight_             {0};
+
+    Block current_                    {};
+    std::unique_ptr<char[]> row_buf_  {};
+    size_t row_buf_size_              {0};
+    uint64_t rows_                    {0};
+
+    // blocks handed to the compressors, oldest first; `first_seq_` is
+    // the sequence number of the front one, `next_seq_` the next one a
+    // compressor should pick up
+    std::deque<Block> in_flight_      {};
+    uint64_t first_seq_               {0};
+    uint64_t next_seq_                {0};
+    uint64_t sealed_                  {0};
+    bool stop_                        {false};
+    std::mutex mtx_                   {};
+    std::condition_variable change_   {};
+
+    uint64_t coffset_                 {0};
+    uint64_t uoffset_                 {0};
+    std::string index_                {};
+
+    // one deflate stream per compressor, set up on the calling thread
+    // (where a failure can be thrown) before any of them starts
+    std::unique_ptr<z_stream_s[]> streams_ {};
+    std::vector<std::jthread> pool_   {};
+};
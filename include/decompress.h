@@ -0,0 +1,24 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+/// whether `path` is a compressed log (.gz or .zst) that has to be read
+/// with `read_decompressed` rather than mapped or split into chunks
+bool is_compressed(std::string_view path) noexcept;
+
+/// the whole decompressed contents of `path` in one buffer (whose
+/// length goes in `size`): .gz files are inflated in memory with zlib,
+/// .zst files are piped through `zstd -dc`; throws if the file can't be
+/// read or is corrupt
+std::unique_ptr<char[]> read_decompressed(const std::string& path, size_t& size);
+
+/// starts a child that decompresses `path` (`zstd -dc` for .zst,
+/// `gzip -dc` for anything else) and returns the read end of the pipe
+/// its output comes out of; the decoding runs alongside whatever reads it
+int open_decompressor(const std::string& path, pid_t& pid);
+
+/// waits for a child from `open_decompressor` (once its pipe is closed);
+/// throws if it failed
+void wait_decompressor(pid_t pid, const std::string& path);
@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include <string>
+
+/// tails the live daily log as EZproxy appends to it (woken by inotify
+/// rather than polling), and moves on to the next day's log once it
+/// shows up in the same directory (at midnight)
+class LogTail final {
+  public:
+    /// starts at the beginning of `path`, which doesn't have to exist
+    /// yet; lines are handed out at most `chunk_bytes` at a time
+    LogTail(std::string path, size_t chunk_bytes);
+    ~LogTail();
+
+    LogTail(const LogTail&)            = delete;
+    LogTail& operator=(const LogTail&) = delete;
+
+    /// waits up to `timeout_ms` for complete lines that haven't been
+    /// handed out yet and puts them in `buffer` (`size` bytes); false if
+    /// there weren't any in time. a partial line at the end of the live
+    /// log is held back until its newline arrives, except once the log
+    /// has been rotated
+    bool next(std::unique_ptr<char[]>& buffer, size_t& size, int timeout_ms);
+
+    /// the log being tailed
+    const std::string& path() const noexcept { return path_; }
+
+  private:
+    bool read_lines(std::unique_ptr<char[]>& buffer, size_t& size, bool whole);
+    std::string next_log();
+    void open_current();
+
+    std::string dir_     {};
+    std::string path_    {};
+    size_t chunk_bytes_  {0};
+    int fd_              {-1};
+    int inotify_         {-1};
+    // where the first line not handed out yet starts
+    size_t offset_       {0};
+    // whether a new log might have appeared since we last looked
+    bool check_next_     {true};
+};
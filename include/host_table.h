@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// interns shortened URLs: every distinct host gets a small id (0, 1,
+/// 2, ... in order of first sighting) and one canonical copy
+///
+/// there are only a few thousand distinct hosts in a year of logs, so
+/// after the first few files every lookup is a hit in a small
+/// open-addressing table
+class HostTable final {
+  public:
+    HostTable();
+
+    /// the id of `host`, adding it if it hasn't been seen before
+    uint32_t intern(std::string_view host);
+
+    /// the canonical copy of the host with id `id`; stays valid for as
+    /// long as the table does
+    std::string_view host(uint32_t id) const noexcept { return hosts_[id]; }
+
+    size_t size() const noexcept { return hosts_.size(); }
+
+    /// writes the id -> host dictionary as a two-column TSV
+    void write(FILE* out) const;
+
+  private:
+    struct Slot {
+        uint32_t hash {0};
+        // id + 1; 0 marks an empty slot
+        uint32_t id   {0};
+    };
+
+    void grow();
+
+    std::vector<Slot> slots_      {};
+    // a deque never moves its elements, so views of them stay valid
+    std::deque<std::string> hosts_ {};
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/// a client address as its 16 bytes, IPv4 addresses mapped into IPv6
+/// (::ffff:a.b.c.d), so every address is the same fixed width; all
+/// zeros (::, which no client has) means there's none
+struct IpAddress {
+    std::array<uint8_t, 16> bytes {};
+
+    bool empty() const noexcept;
+    bool is_v4() const noexcept;
+};
+
+/// the longest text `format_ip` writes ("ffff:...:ffff")
+constexpr size_t MAX_IP_TEXT {39};
+
+/// the address in `text` ("196.1.228.69" or "2001:db8::1"), or an empty
+/// one if it's neither; IPv4 is parsed by hand, as it's nearly every
+/// line, and IPv6 with inet_pton
+IpAddress parse_ip(std::string_view text) noexcept;
+
+/// zeroes everything after an IPv4 address's /24, or an IPv6 one's /48:
+/// the network, without the host
+void truncate_ip(IpAddress& address) noexcept;
+
+/// writes `address` as text (dotted quad for IPv4, RFC 5952 for IPv6)
+/// to `out`, which needs room for MAX_IP_TEXT bytes, and returns the
+/// end of what it wrote; nothing for an empty address
+char* format_ip(char* out, const IpAddress& address) noexcept;
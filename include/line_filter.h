@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "log_format.h"
+
+/// how many lines each of LineFilter's predicates threw out
+struct FilterCounts {
+    size_t no_barcode    {0};
+    size_t excluded_host {0};
+    size_t outside_dates {0};
+
+    FilterCounts& operator+=(const FilterCounts& other) noexcept;
+    size_t total() const noexcept;
+};
+
+/// which lines to throw out, on top of the ones without a barcode
+struct FilterRules {
+    // client hosts (%h) whose lines are dropped, sorted
+    std::vector<std::string> excluded_hosts {};
+    // the first and last day (yyyymmdd, as from raw_day) to keep
+    int32_t first_day {0};
+    int32_t last_day  {INT32_MAX};
+    // still parse the lines these (and the barcode check) drop, so
+    // --stats can count their traffic
+    bool tally_dropped {false};
+};
+
+/// cheap checks on a raw line, made before it's lexed, that throw out
+/// the lines we'd drop anyway: no barcode ("-"), a client host in the
+/// exclusion list, or a date outside the window
+///
+/// the fields are found by hopping from space to space with memchr,
+/// which only splits like lex_fields up to the line's first quote; a
+/// line whose quote comes before a field a predicate needs is checked
+/// again once it's been lexed
+class LineFilter final {
+  public:
+    /// `rules` must outlive the filter
+    LineFilter(const FieldLayout& layout, const FilterRules& rules);
+
+    enum class Verdict {
+        KEEP,
+        DROP,
+        // dropped, but parsed for the stats (FilterRules::tally_dropped)
+        TALLY,
+        // couldn't tell from the raw line; check the lexed fields
+        LEX
+    };
+
+    /// checks the raw `line`; a line that's dropped (or tallied) is
+    /// counted in `counts` under the first predicate that rejects it (in
+    /// field order)
+    Verdict check(std::string_view line, FilterCounts& counts) const noexcept;
+
+    /// the same predicates on a line's lexed `fields`; never LEX
+    Verdict check(const std::string_view* fields, FilterCounts& counts) const noexcept;
+
+  private:
+    enum class Check { BARCODE, HOST, DATE };
+
+    struct Predicate {
+        size_t field {0};
+        Check check  {Check::BARCODE};
+    };
+
+    bool rejects(const Predicate& predicate, std::string_view field,
+                 FilterCounts& counts) const noexcept;
+
+    const FilterRules* rules_             {nullptr};
+    // what a rejected line gets: DROP, or TALLY
+    Verdict rejected_                     {Verdict::DROP};
+    // the predicates in use, in field order
+    std::array<Predicate, 3> predicates_  {};
+    size_t count_                         {0};
+};
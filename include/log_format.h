@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/// the LogFormat our EZproxy server is configured with: NCSA combined,
+/// with the session in the third field
+constexpr char EZPROXY_LOG_FORMAT[] {
+    "%h %u %{ezproxy-session}i %t \"%r\" %s %b \"%{Referer}i\" \"%{User-Agent}i\""};
+
+/// a field a LogFormat doesn't have
+constexpr size_t NO_FIELD {SIZE_MAX};
+
+/// the most fields a line is lexed into
+constexpr size_t MAX_FIELDS {32};
+
+/// which of a line's (quote-aware, space-separated) fields holds each
+/// thing LineParser needs; `%t` is two fields ("[05/Mar/2026:00:00:02"
+/// and "-0500]"), the offset right after `time`
+struct FieldLayout {
+    size_t host    {NO_FIELD};
+    size_t user    {NO_FIELD};
+    size_t session {NO_FIELD};
+    size_t time    {NO_FIELD};
+    size_t request {NO_FIELD};
+    size_t status  {NO_FIELD};
+    size_t bytes   {NO_FIELD};
+    // how many fields to lex: one past the last of the above
+    size_t fields  {0};
+
+    constexpr bool operator==(const FieldLayout&) const noexcept = default;
+};
+
+/// the layout of EZPROXY_LOG_FORMAT (and of the same format without the
+/// referer and user agent, which it never looks at)
+constexpr FieldLayout EZPROXY_LAYOUT {0, 1, 2, 3, 5, 6, 7, 8};
+
+/// the layout of NCSA common, `%h %l %u %t "%r" %s %b`: EZproxy's
+/// default LogFormat, without a session
+constexpr FieldLayout COMMON_LAYOUT {0, 2, NO_FIELD, 3, 5, 6, 7, 8};
+
+/// an Apache-style LogFormat directive, as in EZproxy's config.txt:
+///
+///   %h %u %{ezproxy-session}i %t "%r" %s %b
+///
+/// directives are separated by spaces, and `%r` has to be quoted; we use
+/// %h (or %a), %u, %{ezproxy-session}i, %t, %r, %s and %b (or %B), and
+/// skip over anything else. %u, %t and %r are required
+class LogFormat final {
+  public:
+    /// throws std::runtime_error if `directive` can't be parsed
+    explicit LogFormat(std::string_view directive);
+
+    const FieldLayout& layout() const noexcept { return layout_; }
+    const std::string& directive() const noexcept { return directive_; }
+
+  private:
+    std::string directive_ {};
+    FieldLayout layout_    {};
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+#include "ip_address.h"
+#include "timestamp.h"
+
+/// one cleaned log entry; every field except the reformatted date is a
+/// view into the buffer the line was read into, so a record must not
+/// outlive that buffer
+struct LogRecord {
+    std::string_view ip       {};
+    std::string_view barcode  {};
+    std::string_view session  {};
+    std::string_view fullurl  {};
+    std::string_view url      {};
+    // the client's address, when ColumnRewrites::truncate_ips asks for
+    // it to be parsed; it's what's written in the ip column then (an
+    // empty one, for a host that isn't an address, as an empty field)
+    IpAddress address         {};
+    IsoDate date              {};
+    // UTC seconds since 1970
+    int64_t epoch             {0};
+    // the response's size in bytes ("-" is 0)
+    uint64_t bytes            {0};
+    // the HTTP status (0 if it wasn't a number)
+    uint16_t status           {0};
+    // whether ColumnRewrites percent-decoded these (a literal '%' in
+    // them is escaped on the way out)
+    bool barcode_decoded      {false};
+    bool fullurl_decoded      {false};
+
+    std::string_view date_view() const noexcept {
+        return {date.data(), date.size()};
+    }
+};
+
+/// how LineParser changes columns on their way into a LogRecord
+struct ColumnRewrites {
+    // percent-decode ("%2F" -> "/") these; the barcode also loses the
+    // "%a0x" some of them are logged with
+    bool decode_barcode {false};
+    bool decode_fullurl {false};
+    // parse the client host into `address`, keeping only its network:
+    // the /24 of an IPv4 address, the /48 of an IPv6 one
+    bool truncate_ips   {false};
+};
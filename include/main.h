@@ -2,17 +2,37 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string_view>
 #include <vector>
 #include <cmath>
 #include <algorithm>
 #include <csignal>
 #include <ctime>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
 #include <chrono>
+#include <functional>
+#include <charconv>
 
 #pragma GCC system_header
 #include <fmt/core.h>
+#include <fmt/format.h>
 
+#include "alloc_counter.h"
+#include "bgzf.h"
+#include "follow.h"
 #include "glob.h"
+#include "host_table.h"
+#include "merge.h"
+#include "options.h"
+#include "output.h"
+#include "ordered_pool.h"
+#include "parse.h"
+#include "tar_reader.h"
+#include "traffic_stats.h"
 #include "indicators.hpp"
 #include "rang.hpp"
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/// read-only mapping of a whole file (or of bytes [begin, end) of it),
+/// advised for a single sequential pass; lines handed out by
+/// `for_each_line` point straight into it and are only valid for as
+/// long as the mapping lives
+class MappedFile final {
+  public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const std::string& path, size_t begin, size_t end);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const noexcept {
+        return {data_ + skip_, size_ - skip_};
+    }
+
+  private:
+    void map(int fd, const std::string& path, size_t begin, size_t end);
+
+    const char* data_ {nullptr};
+    size_t size_      {0};
+    // mappings start on a page boundary; this is how far before `begin`
+    size_t skip_      {0};
+};
+
+/// calls `fun(std::string_view)` for every line in `buffer` (without
+/// the trailing newline, like `std::getline`)
+template <typename F>
+void for_each_line(std::string_view buffer, F&& fun) {
+    const char* cur { buffer.data() };
+    const char* end { cur + buffer.size() };
+    while (cur < end) {
+        const auto* nl { static_cast<const char*>(
+                memchr(cur, '\n', static_cast<size_t>(end - cur))) };
+        const char* eol { nl == nullptr ? end : nl };
+        fun(std::string_view(cur, static_cast<size_t>(eol - cur)));
+        cur = eol + 1;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <future>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parse.h"
+
+/// merges the same day's log from several EZproxy nodes into one stream
+/// of rows in epoch order (a k-way merge on a heap); rows with the same
+/// epoch come out in node order, then in the order they were logged
+///
+/// each log is parsed a chunk of about `chunk_bytes` at a time, with its
+/// next chunk parsed ahead on another thread, so at most two chunks per
+/// node are in memory however big the logs are (compressed logs are one
+/// chunk, as they can't be split)
+class LogMerger final {
+  public:
+    /// the logs are in `format` and filtered by `rules`, which must
+    /// outlive the merger, with `rewrites` applied
+    LogMerger(const std::vector<std::string>& paths, size_t chunk_bytes,
+              const LogFormat& format, const FilterRules& rules,
+              const ColumnRewrites& rewrites);
+    ~LogMerger();
+
+    LogMerger(const LogMerger&)            = delete;
+    LogMerger& operator=(const LogMerger&) = delete;
+
+    /// the next row, or nullptr once every log is done
+    const LogRecord* next();
+
+    /// whether a chunk has been used up since the last `release`; the
+    /// rows from it (and the input they point into) stay valid until then
+    bool retiring() const noexcept { return !retired_.empty(); }
+    void release() noexcept {
+        retired_.clear();
+        tallied_.clear();
+    }
+
+    /// the lines from the chunks parsed since the last `release` that
+    /// were dropped but are still to be counted in the stats
+    /// (FilterRules::tally_dropped); tally them before releasing
+    const std::vector<LogRecord>& tallied() const noexcept { return tallied_; }
+
+    /// the lines thrown out of the chunks parsed so far
+    const FilterCounts& rejected() const noexcept { return rejected_; }
+
+  private:
+    struct NodeLog {
+        // defined out of line: the implicit ones are too big for -Winline
+        NodeLog();
+        NodeLog(NodeLog&&) noexcept;
+        NodeLog& operator=(NodeLog&&) noexcept;
+        ~NodeLog();
+
+        std::string path          {};
+        std::vector<Task> chunks  {};
+        size_t next_chunk         {0};
+        Batch batch               {};
+        size_t row                {0};
+        std::future<Batch> ahead  {};
+    };
+
+    bool advance(NodeLog& log);
+
+    const LogFormat* format_   {nullptr};
+    const FilterRules* rules_  {nullptr};
+    ColumnRewrites rewrites_   {};
+    std::vector<NodeLog> logs_ {};
+    // (epoch, node) of every node's current row; smallest on top
+    using Head = std::pair<int64_t, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads_ {};
+    // the node whose row `next` returned last, still to be advanced
+    size_t current_     {0};
+    bool started_       {false};
+    std::vector<Batch> retired_ {};
+    std::vector<LogRecord> tallied_ {};
+    FilterCounts rejected_      {};
+};
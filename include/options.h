@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "line_filter.h"
+#include "log_format.h"
+#include "log_record.h"
+
+/// command line settings for step 1
+struct Options {
+    // defined out of line: the implicit ones are too big for -Winline
+    Options();
+    Options(const Options&);
+    Options(Options&&) noexcept;
+    Options& operator=(const Options&);
+    Options& operator=(Options&&) noexcept;
+    ~Options();
+
+    // worker threads parsing logs (1: everything on the main thread)
+    size_t threads    {1};
+    // with more than one thread, logs bigger than this many bytes are
+    // split into newline-aligned chunks that are parsed in parallel;
+    // also how much --pipe reads at a time
+    size_t chunk_size {32 << 20};
+    // write interned host ids in the url column (and the id -> host
+    // dictionary next to the output) instead of the hosts themselves
+    bool host_ids     {false};
+    // writev the full URLs straight out of the input instead of
+    // copying them into the output buffer
+    bool gather       {false};
+    // compress the output with zstd at this level (0: don't)
+    int zstd_level    {0};
+    // write the output as BGZF (block gzip) at this level, with a block
+    // index next to it (0: don't)
+    int bgzf_level    {0};
+    // read log text from standard input and write the cleaned rows to
+    // standard output instead of globbing logs/ and writing intermediate/
+    bool pipe         {false};
+    // read the daily logs out of this tar file (.tar, .tar.gz, .tgz or
+    // .tar.zst) instead of globbing logs/ (empty: don't)
+    std::string archive {};
+    // once the complete days are done, keep writing the live log's rows
+    // as they're logged (until SIGINT)
+    bool follow       {false};
+    // tally requests, bytes and status classes per day and host (of
+    // every line, dropped or not), and write them next to the output
+    bool stats        {false};
+    // where the fields are in the logs' lines
+    LogFormat log_format {EZPROXY_LOG_FORMAT};
+    // lines dropped before they're parsed: client hosts to leave out,
+    // and the days to keep
+    FilterRules filter   {};
+    // the columns to percent-decode, and whether to truncate addresses
+    ColumnRewrites rewrites {};
+};
+
+/// parses `argv`; prints usage and exits on anything it doesn't understand
+Options parse_args(int argc, char** argv);
@@ -0,0 +1,98 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/// calls `produce(i)` for every i in [0, count) on `threads` worker
+/// threads and hands each result to `consume` on the calling thread, in
+/// order of i, so whatever `consume` writes comes out exactly as it
+/// would from a plain loop
+///
+/// at most `2 * threads` results are in flight at once, so a slow
+/// consumer can't make finished results pile up. an exception thrown by
+/// `produce` (or `consume`) stops the workers and is rethrown here.
+/// with one thread (or fewer) there's no pool at all
+template <typename T, typename Produce, typename Consume>
+void ordered_parallel_for(size_t count, size_t threads,
+                          Produce&& produce, Consume&& consume) {
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            consume(produce(i));
+        return;
+    }
+
+    const size_t window { 2 * threads };
+    std::vector<std::optional<T>> results(count);
+    std::vector<std::exception_ptr> errors(count);
+    std::mutex mtx                 {};
+    std::condition_variable change {};
+    size_t next     {0};
+    size_t consumed {0};
+    bool stop       {false};
+
+    const auto work = [&] {
+        for (;;) {
+            size_t i {0};
+            {
+                std::unique_lock lock {mtx};
+                change.wait(lock, [&] {
+                    return stop || next >= count || next < consumed + window;
+                });
+                if (stop || next >= count)
+                    return;
+                i = next++;
+            }
+            std::optional<T> result   {};
+            std::exception_ptr error  {};
+            try {
+                result.emplace(produce(i));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            {
+                const std::lock_guard lock {mtx};
+                results[i] = std::move(result);
+                errors[i]  = error;
+            }
+            change.notify_all();
+        }
+    };
+
+    // declared after everything `work` uses, so it's joined first
+    std::vector<std::jthread> pool {};
+    pool.reserve(threads);
+    for (size_t t = 0; t < threads; ++t)
+        pool.emplace_back(work);
+
+    try {
+        for (size_t i = 0; i < count; ++i) {
+            std::optional<T> result  {};
+            std::exception_ptr error {};
+            {
+                std::unique_lock lock {mtx};
+                change.wait(lock, [&] {
+                    return results[i].has_value() || errors[i] != nullptr;
+                });
+                result = std::move(results[i]);
+                results[i].reset();
+                error = errors[i];
+                ++consumed;
+            }
+            change.notify_all();
+            if (error)
+                std::rethrow_exception(error);
+            consume(std::move(*result));
+        }
+    } catch (...) {
+        {
+            const std::lock_guard lock {mtx};
+            stop = true;
+        }
+        change.notify_all();
+        throw;
+    }
+}
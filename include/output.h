@@ -0,0 +1,197 @@
+#pragma once
+#include <memory>
+#include <csignal>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "log_record.h"
+
+/// where the bytes of the cleaned output go
+class OutputSink {
+  public:
+    virtual ~OutputSink() = default;
+    /// writes all of `bytes` (or throws)
+    virtual void write(std::string_view bytes) = 0;
+    /// writes all the pieces, in order; sinks that can't do better than
+    /// one write per piece can leave this alone
+    virtual void write_gather(std::span<const iovec> pieces);
+    /// flushes anything still held back; called once, after the last write
+    virtual void finish() = 0;
+};
+
+/// write(2)s straight to a file descriptor, which it owns
+class FdSink final : public OutputSink {
+  public:
+    /// creates (or truncates) `path`
+    explicit FdSink(const std::string& path);
+    /// takes over `fd` (standard output, say); `name` is for errors
+    FdSink(int fd, std::string name);
+    ~FdSink() override;
+
+    FdSink(const FdSink&)            = delete;
+    FdSink& operator=(const FdSink&) = delete;
+
+    void write(std::string_view bytes) override;
+    /// writev(2)s up to IOV_MAX pieces at a time
+    void write_gather(std::span<const iovec> pieces) override;
+    void finish() override;
+
+  private:
+    int fd_ {-1};
+    std::string path_ {};
+};
+
+/// feeds everything written to it to the standard input of a child
+/// process (a compressor) that writes the file itself
+class PipeSink final : public OutputSink {
+  public:
+    /// starts `argv[0]` (looked up in PATH) with `argv`
+    explicit PipeSink(const std::vector<std::string>& argv);
+    ~PipeSink() override;
+
+    PipeSink(const PipeSink&)            = delete;
+    PipeSink& operator=(const PipeSink&) = delete;
+
+    /// throws if the child has gone away, saying how it went
+    void write(std::string_view bytes) override;
+    /// writev(2)s up to IOV_MAX pieces at a time, like FdSink
+    void write_gather(std::span<const iovec> pieces) override;
+    /// closes the pipe and waits for the child; throws if it failed
+    void finish() override;
+
+  private:
+    // throws for a write that failed with `error`
+    [[noreturn]] void fail(int error);
+    // closes the pipe and reaps the child; returns what went wrong (its
+    // exit status, or the signal that killed it), or "" if nothing did
+    std::string close_and_wait();
+
+    int fd_              {-1};
+    pid_t pid_           {-1};
+    std::string command_ {};
+    // SIGPIPE is ignored while the child runs (see the constructor)
+    struct sigaction old_sigpipe_ {};
+};
+
+/// a sink that writes `path` (standard output if it's empty) as a zstd
+/// stream, compressed at `level` on every core (by the zstd command
+/// line tool)
+std::unique_ptr<OutputSink> make_zstd_sink(const std::string& path, int level);
+
+/// the first line of the cleaned output
+constexpr std::string_view TSV_HEADER {
+    "ip\tbarcode\tsession\tdate_and_time\tepoch\turl\tfullurl\n"
+};
+
+/// how many fields had to be escaped on their way out
+struct EscapeCounts {
+    // fields with a control character (a tab or line break, mostly)
+    size_t control      {0};
+    // fields that weren't valid UTF-8
+    size_t invalid_utf8 {0};
+
+    EscapeCounts operator-(const EscapeCounts& before) const noexcept;
+    bool any() const noexcept { return control > 0 || invalid_utf8 > 0; }
+};
+
+/// an upper bound on how many bytes `serialize_row` writes for this row
+size_t max_row_size(const LogRecord& rec, std::string_view url) noexcept;
+
+/// writes `rec` as one tab-separated line (newline included) to `out`
+/// and returns the end of what it wrote, counting the fields it had to
+/// escape in `escaped`; `url` is what goes in the url column: the host
+/// itself, or its id
+char* serialize_row(char* out, const LogRecord& rec, std::string_view url,
+                    EscapeCounts& escaped) noexcept;
+
+/// `value` the way it's written in a column of the cleaned output
+/// (escaped like an undecoded field; see RowWriter)
+std::string escape_field(std::string_view value);
+
+/// turns rows into the bytes of the cleaned output
+///
+/// tabs, newlines and carriage returns inside a field would shift or
+/// split columns, other control characters (NUL, say) have no business
+/// in a text file, and bytes that aren't UTF-8 trip up `fread`, so
+/// they're all written percent-encoded (%09, %0A, %00; %E9 for a stray
+/// Latin-1 'é'), the same way the rest of the URL is encoded. in a
+/// percent-decoded column a '%' is written as %25 too, so every escape
+/// there is one of ours. the fields are checked 16 bytes at a time: a
+/// field that's all printable ASCII (nearly every one) is copied as it
+/// is
+class RowWriter {
+  public:
+    virtual ~RowWriter() = default;
+    /// the column names
+    virtual void header() = 0;
+    /// `url` is what goes in the url column: the host itself, or its id
+    virtual void row(const LogRecord& rec, std::string_view url) = 0;
+    /// called before the buffer the rows so far point into goes away
+    virtual void release_input() {}
+    /// hands everything held so far to the sink
+    virtual void flush() = 0;
+    /// flushes, and writes whatever closes the output; called once,
+    /// after the last row
+    virtual void finish() { flush(); }
+
+    /// the fields escaped so far
+    const EscapeCounts& escaped() const noexcept { return escaped_; }
+
+  protected:
+    EscapeCounts escaped_ {};
+};
+
+/// serializes rows as tab-separated lines into a big buffer and hands
+/// it to the sink in multi-megabyte writes
+class TsvWriter final : public RowWriter {
+  public:
+    TsvWriter(OutputSink& sink, size_t buffer_size);
+
+    TsvWriter(const TsvWriter&)            = delete;
+    TsvWriter& operator=(const TsvWriter&) = delete;
+
+    void header() override;
+    void row(const LogRecord& rec, std::string_view url) override;
+    void flush() override;
+
+  private:
+    void reserve(size_t bytes);
+
+    OutputSink* sink_               {nullptr};
+    std::unique_ptr<char[]> buffer_ {};
+    size_t capacity_                {0};
+    size_t used_                    {0};
+};
+
+/// writes the same bytes as TsvWriter, but the full URL (by far the
+/// longest field) isn't copied: it goes to the sink as a pointer into
+/// the input, next to the rest of the row, which is serialized into a
+/// small scratch buffer. rows are handed over in batches of up to
+/// IOV_MAX pieces, and always before the input is released
+class GatherWriter final : public RowWriter {
+  public:
+    explicit GatherWriter(OutputSink& sink);
+
+    GatherWriter(const GatherWriter&)            = delete;
+    GatherWriter& operator=(const GatherWriter&) = delete;
+
+    void header() override;
+    void row(const LogRecord& rec, std::string_view url) override;
+    void release_input() override { flush(); }
+    void flush() override;
+
+  private:
+    void add_piece(const char* data, size_t size);
+
+    OutputSink* sink_                {nullptr};
+    std::unique_ptr<char[]> scratch_ {};
+    size_t used_                     {0};
+    std::vector<iovec> pieces_       {};
+    // a row's newline goes at the start of the next row's scratch
+    // bytes, so each row is (usually) only two pieces
+    bool pending_newline_            {false};
+};
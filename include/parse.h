@@ -0,0 +1,151 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "line_filter.h"
+#include "log_format.h"
+#include "log_record.h"
+#include "mapped_file.h"
+#include "percent.h"
+#include "timestamp.h"
+#include "tokenize.h"
+
+/// turns raw log lines into LogRecords, finding their fields where a
+/// LogFormat says they are, after a LineFilter has thrown out the lines
+/// it can, and rewriting the columns it's asked to; holds the
+/// per-thread state (the timestamp cache, the filter's counts and the
+/// decoded fields), so each worker needs its own
+///
+/// the known layouts (EZPROXY_LAYOUT and COMMON_LAYOUT) each get a
+/// parser instantiated with their field indices as constants, so there
+/// are no per-line lookups or checks for missing fields; any other
+/// format gets the same code reading the indices from the layout
+class LineParser final {
+  public:
+    /// `format` only needs to live as long as the constructor call, but
+    /// `rules` as long as the parser
+    LineParser(const LogFormat& format, const FilterRules& rules,
+               const ColumnRewrites& rewrites);
+
+    /// parses every line of `text`, appending the ones we keep to `rows`
+    void parse(std::string_view text, std::vector<LogRecord>& rows);
+
+    /// the lines thrown out so far, by the filter or (for those it
+    /// couldn't decide on) once lexed
+    const FilterCounts& rejected() const noexcept { return state_.rejected; }
+
+    /// hands over the decoded fields the rows parsed so far point into
+    DecodeArena take_decoded() noexcept { return std::move(state_.decoded); }
+
+    /// hands over the lines dropped but still to be counted in the stats
+    /// (FilterRules::tally_dropped), parsed as far as TrafficStats needs:
+    /// date, url, status and bytes
+    std::vector<LogRecord> take_tallied() noexcept { return std::move(state_.tallied); }
+
+    /// what the parse loops work with
+    struct State {
+        FieldLayout layout     {};
+        LineFilter filter;
+        TimestampConverter dates {};
+        FilterCounts rejected  {};
+        ColumnRewrites rewrites {};
+        DecodeArena decoded    {};
+        std::vector<LogRecord> tallied {};
+    };
+    using text_parser = void (*)(State&, std::string_view, std::vector<LogRecord>&);
+
+  private:
+    State state_;
+    text_parser parse_ {nullptr};
+};
+
+/// a newline-aligned byte range [begin, end) of one input log; big logs
+/// get split into several of these so they can be parsed in parallel
+struct Task {
+    size_t file  {0};
+    size_t begin {0};
+    size_t end   {0};
+};
+
+/// splits every file into tasks of roughly `chunk_bytes` (0: don't
+/// split; compressed files never are), in file and then byte order, so
+/// concatenating the tasks' rows gives the same rows as parsing the
+/// files one after another
+std::vector<Task> plan_tasks(const std::vector<std::string>& files,
+                             size_t chunk_bytes);
+
+/// the rows parsed from one Task, plus whatever owns the bytes they
+/// point into (the mapping with -DMMAPINPUT, a read buffer without, or
+/// the decompressed log, and the decoded fields), and how many lines
+/// were thrown out; with FilterRules::tally_dropped, the lines thrown
+/// out for their barcode or host too, for the stats
+struct Batch {
+    // defined out of line: the implicit ones are too big for -Winline
+    Batch();
+    Batch(Batch&&) noexcept;
+    Batch& operator=(Batch&&) noexcept;
+    ~Batch();
+
+    std::shared_ptr<const MappedFile> mapping {};
+    std::unique_ptr<char[]> buffer            {};
+    DecodeArena decoded                       {};
+    std::vector<LogRecord> rows               {};
+    std::vector<LogRecord> tallied            {};
+    FilterCounts rejected                     {};
+};
+
+/// reads and parses `task`'s bytes of `path`, in `format`, keeping the
+/// lines `rules` let through and applying `rewrites`; safe to call from
+/// several threads
+Batch parse_task(const std::string& path, const Task& task, const LogFormat& format,
+                 const FilterRules& rules, const ColumnRewrites& rewrites);
+
+/// parses the log lines (in `format`, filtered by `rules`, with
+/// `rewrites` applied) in `buffer` (its first `size` bytes), which the
+/// batch takes over
+Batch parse_buffer(std::unique_ptr<char[]> buffer, size_t size, const LogFormat& format,
+                   const FilterRules& rules, const ColumnRewrites& rewrites);
+
+/// a stream of bytes read front to back
+class ByteSource {
+  public:
+    virtual ~ByteSource() = default;
+    /// reads up to `size` bytes into `out`; returns how many, 0 at the
+    /// end of the stream (or throws)
+    virtual size_t read(char* out, size_t size) = 0;
+};
+
+/// read(2)s from a file descriptor it doesn't own (standard input, say)
+class FdSource final : public ByteSource {
+  public:
+    /// `name` is for errors
+    FdSource(int fd, std::string name);
+    size_t read(char* out, size_t size) override;
+
+  private:
+    int fd_           {-1};
+    std::string name_ {};
+};
+
+/// cuts a stream of log text (a pipe, say) into buffers of whole lines
+/// of roughly `chunk_bytes` each, read with as few reads as it can
+class LineChunker final {
+  public:
+    LineChunker(ByteSource& source, size_t chunk_bytes);
+
+    LineChunker(const LineChunker&)            = delete;
+    LineChunker& operator=(const LineChunker&) = delete;
+
+    /// the next buffer of whole lines (only the very last line of the
+    /// stream may be missing its newline); false at the end of the stream
+    bool next(std::unique_ptr<char[]>& buffer, size_t& size);
+
+  private:
+    ByteSource* source_            {nullptr};
+    size_t chunk_bytes_            {0};
+    // the partial line at the end of the last read, for the next buffer
+    std::string carry_             {};
+    bool eof_                      {false};
+};
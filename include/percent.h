@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/// the offset of the first '%' in `text`, or its size if there isn't one
+size_t find_percent(std::string_view text) noexcept;
+
+/// percent-decodes `text` into `out`, which needs room for text.size()
+/// bytes, and returns the end of what it wrote; the bytes before `from`
+/// (the first '%', from find_percent) are copied as they are, and so is
+/// a '%' that isn't followed by two hex digits. '+' is left alone
+///
+/// the runs between '%'s are found and copied 16 bytes at a time with
+/// SSE2
+char* percent_decode(std::string_view text, size_t from, char* out) noexcept;
+
+/// where decoded fields are kept: blocks that never move, so the views
+/// into them stay valid as more are added, and that go away with it
+class DecodeArena final {
+  public:
+    DecodeArena();
+    DecodeArena(DecodeArena&&) noexcept;
+    DecodeArena& operator=(DecodeArena&&) noexcept;
+    ~DecodeArena();
+
+    DecodeArena(const DecodeArena&)            = delete;
+    DecodeArena& operator=(const DecodeArena&) = delete;
+
+    /// `text`, percent-decoded into the arena, or `text` itself if it
+    /// doesn't have a '%' in it
+    std::string_view decode(std::string_view text);
+
+  private:
+    std::vector<std::unique_ptr<char[]>> blocks_ {};
+    char* next_                                  {nullptr};
+    char* end_                                   {nullptr};
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+#include "parse.h"
+
+/// streams the regular files out of a tar archive (ustar, with GNU long
+/// names and pax paths) in one sequential pass, without extracting
+/// anything; .tar.gz/.tgz and .tar.zst archives are decompressed by a
+/// child process as they're read
+///
+/// as a ByteSource, it reads the data of the current member: 0 means
+/// that member is done, not the archive
+class TarReader final : public ByteSource {
+  public:
+    explicit TarReader(const std::string& path);
+    ~TarReader() override;
+
+    TarReader(const TarReader&)            = delete;
+    TarReader& operator=(const TarReader&) = delete;
+
+    /// skips whatever is left of the current member and moves to the
+    /// next regular file, whose path goes in `name`; false at the end of
+    /// the archive
+    bool next_member(std::string& name);
+    size_t read(char* out, size_t size) override;
+    /// checks that the decompressor (if any) was happy; call it once
+    /// `next_member` has returned false
+    void finish();
+
+  private:
+    size_t raw_read(char* out, size_t size);
+    void read_exact(char* out, size_t size);
+    void skip(uint64_t size);
+    // the data of a long name or pax header (`what`, for errors)
+    std::string read_string(uint64_t size, std::string_view what);
+
+    std::string path_               {};
+    // set by the time `fd_` is initialized (with a decompressor)
+    pid_t pid_                      {-1};
+    int fd_                         {-1};
+    FdSource source_;
+    std::unique_ptr<char[]> buffer_ {};
+    size_t pos_                     {0};
+    size_t end_                     {0};
+    // of the current member: data not read yet, then the padding up to
+    // the next 512-byte record
+    uint64_t remaining_             {0};
+    uint64_t padding_               {0};
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+/// length of the "[dd/Mon/yyyy:hh:mm:ss" half of EZproxy's %t field
+constexpr size_t RAW_DATE_LEN {21};
+/// length of the "yyyy-mm-dd hh:mm:ss" date we write out
+constexpr size_t ISO_DATE_LEN {19};
+
+using IsoDate = std::array<char, ISO_DATE_LEN>;
+
+/// the original strptime/strftime conversion; locale-aware, accepts
+/// anything strptime does, and is slow
+void fix_whole_date(std::string_view adate, IsoDate& out) noexcept;
+
+/// the day of a "[dd/Mon/yyyy..." date as the number yyyymmdd (so days
+/// compare like numbers), or 0 if it doesn't start like that
+int32_t raw_day(std::string_view adate) noexcept;
+
+/// converts the fixed-width %t date by moving bytes around, remembering
+/// the last second it saw (consecutive lines almost always share one);
+/// anything that isn't exactly "[dd/Mon/yyyy:hh:mm:ss" is handed to
+/// `fix_whole_date` so the output matches it either way
+///
+/// `aoffset` is the "-0400]" half of %t; `epoch` gets UTC seconds since
+/// 1970, so it keeps increasing across DST changes where the (local)
+/// ISO date jumps back an hour
+class TimestampConverter final {
+  public:
+    void convert(std::string_view adate, std::string_view aoffset,
+                 IsoDate& out, int64_t& epoch) noexcept;
+
+  private:
+    bool convert_fixed(const char* in, IsoDate& out) const noexcept;
+    int32_t offset_seconds(std::string_view aoffset) noexcept;
+    int64_t local_seconds(const IsoDate& iso) noexcept;
+
+    std::array<char, RAW_DATE_LEN> last_in_ {};
+    int32_t last_in_offset_                {0};
+    IsoDate last_out_                      {};
+    int64_t last_epoch_                    {0};
+
+    // the offset only changes twice a year and the day once a day
+    std::array<char, 5> last_offset_in_    {};
+    int32_t last_offset_                   {0};
+    std::array<char, 10> last_day_         {};
+    int64_t last_day_start_                {0};
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/// splits `line` on the spaces that aren't inside double quotes (where
+/// a backslash escapes the next character) into at most `max` fields,
+/// and returns how many it found (anything after the `max`th is left
+/// alone); quoted fields are handed back without their quotes
+///
+/// finds spaces and quotes with AVX2 or SSE2 bitmasks when the CPU has
+/// them (picked once, at the first call), tracks the quoted spans with
+/// a prefix XOR of the quote mask, and drops to a scalar loop for lines
+/// with backslashes in them
+size_t lex_fields(std::string_view line, std::string_view* out, size_t max) noexcept;
+
+/// the URL in a request ("GET <url> HTTP/1.1"): its second word
+std::string_view request_url(std::string_view request) noexcept;
+
+/// the value of a numeric field (the status, or the bytes sent), or 0
+/// for "-" and anything else that isn't a number of up to 16 digits
+///
+/// branchless: the 8 or 16 bytes ending where `field` does are read as
+/// whole words, with the bytes before the field masked to '0's, then
+/// validated and converted with SWAR arithmetic; fields within the
+/// first 16 bytes of `line` (which they're a view into) are read one
+/// character at a time instead
+uint64_t parse_decimal(std::string_view line, std::string_view field) noexcept;
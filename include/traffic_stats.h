@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "host_table.h"
+#include "log_record.h"
+
+/// per-day, per-host traffic totals: requests, bytes sent, and how many
+/// responses had each class of status (1xx to 5xx, and anything else)
+///
+/// rows are tallied by (day, host id) in an open-addressing table over
+/// the entries that have been seen, so it stays small: a day only has
+/// entries for the hosts it actually saw
+class TrafficStats final {
+  public:
+    /// hosts are interned in `hosts`, which must outlive the stats
+    explicit TrafficStats(HostTable& hosts);
+
+    TrafficStats(const TrafficStats&)            = delete;
+    TrafficStats& operator=(const TrafficStats&) = delete;
+
+    /// counts `rec` towards its day and host
+    void add(const LogRecord& rec);
+
+    /// writes the totals as a TSV, one line per day and host, sorted by
+    /// day and then host
+    void write(FILE* out) const;
+
+  private:
+    // 1xx, 2xx, 3xx, 4xx, 5xx, other
+    static constexpr size_t STATUS_CLASSES {6};
+
+    struct Entry {
+        // the day's index in days_ in the high 32 bits, the host id in
+        // the low ones
+        uint64_t key                                    {0};
+        uint64_t bytes                                  {0};
+        uint32_t requests                               {0};
+        std::array<uint32_t, STATUS_CLASSES> statuses   {};
+    };
+
+    uint32_t day_index(const LogRecord& rec);
+    Entry& entry(uint64_t key);
+    void grow();
+
+    HostTable* hosts_              {nullptr};
+    // "YYYY-MM-DD", in order of first sighting
+    std::vector<std::string> days_ {};
+    // the index of the day the last row was on, which the next row
+    // almost always is too
+    uint32_t day_                  {0};
+    std::vector<Entry> entries_    {};
+    // entry index + 1; 0 marks an empty slot
+    std::vector<uint32_t> slots_   {};
+};
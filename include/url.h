@@ -0,0 +1,11 @@
+#pragma once
+#include <string_view>
+
+/// the host part of a logged URL ("https://go.gale.com:443/ps/..." ->
+/// "go.gale.com"), as a view into `fullurl`
+///
+/// skips the scheme and any userinfo, stops at the first '/', '?' or
+/// '#', and strips the port; hosts like "58122.on.worldcat.org" lose
+/// their numeric first label. never allocates or throws: a URL with no
+/// recognizable host gives an empty view
+std::string_view get_small_url(std::string_view fullurl) noexcept;
@@ -0,0 +1,71 @@
+// times fix_whole_date (strptime + strftime) against TimestampConverter
+// on the same %t dates: as they come in a log, a few lines to each
+// second, and with every line on a new second, where the converter's
+// memo never hits
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "timestamp.h"
+
+namespace {
+
+constexpr size_t LINES {2'000'000};
+
+constexpr const char* OFFSET {"-0500]"};
+
+// `LINES` raw dates, `per_second` lines to each second, from the 1st
+// of the month on
+std::vector<std::string> make_dates(size_t per_second) {
+    std::vector<std::string> dates {};
+    dates.reserve(LINES);
+    for (size_t i = 0; i < LINES; ++i) {
+        const auto s { i / per_second };
+        dates.push_back(fmt::format("[{:02}/Mar/2026:{:02}:{:02}:{:02}",
+                                    1 + s / 86400 % 28, s / 3600 % 24,
+                                    s / 60 % 60, s % 60));
+    }
+    return dates;
+}
+
+// nanoseconds per date for `convert(date, out)`, over all of `dates`
+template <typename F>
+double time_per_date(const std::vector<std::string>& dates, F&& convert) {
+    IsoDate out {};
+    uint64_t checksum {0};
+    const auto start { std::chrono::steady_clock::now() };
+    for (const auto& date : dates) {
+        convert(date, out);
+        checksum += static_cast<unsigned char>(out[ISO_DATE_LEN - 1]);
+    }
+    const std::chrono::duration<double, std::nano> took {
+            std::chrono::steady_clock::now() - start };
+    // so the loop can't be optimized away
+    if (checksum == 0)
+        fmt::print("");
+    return took.count() / static_cast<double>(dates.size());
+}
+
+void run(const char* name, const std::vector<std::string>& dates) {
+    const auto old_ns { time_per_date(dates, [](const std::string& date, IsoDate& out) {
+        fix_whole_date(date, out);
+    }) };
+    TimestampConverter converter {};
+    int64_t epoch {0};
+    const auto new_ns { time_per_date(dates, [&](const std::string& date, IsoDate& out) {
+        converter.convert(date, OFFSET, out, epoch);
+    }) };
+    fmt::print("{:<22} fix_whole_date {:7.1f} ns   TimestampConverter {:6.1f} ns   {:5.1f}x\n",
+               name, old_ns, new_ns, old_ns / new_ns);
+}
+
+} // namespace
+
+int main() {
+    run("3 lines per second", make_dates(3));
+    run("every line a second", make_dates(1));
+}
@@ -0,0 +1,76 @@
+// times TsvWriter against the fmt::print it replaced, one call per row
+// into a stdio FILE*, writing the same rows to /dev/null
+
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "output.h"
+
+namespace {
+
+constexpr size_t ROWS {2'000'000};
+
+// the fields of a few typical rows; every thousandth full URL has a tab
+// in it, for TsvWriter to escape
+constexpr std::string_view FULL_URLS[] {
+    "https://search.proquest.com:443/docview/1234567?accountid=35635&db=prod",
+    "https://www.jstor.org:443/stable/10.2307/1234567?seq=1",
+    "http://go.gale.com:443/ps/i.do?p=GVRL&u=nypl&id=GALE%7CCX1234567",
+    "https://public.maximus.newsbank.com:443/?db=asc&q=new+york",
+};
+constexpr std::string_view ESCAPED_URL {"https://www.jstor.org:443/action/doBasicSearch?Query=a\tb"};
+
+std::vector<LogRecord> make_rows() {
+    std::vector<LogRecord> rows (ROWS);
+    for (size_t i = 0; i < ROWS; ++i) {
+        auto& rec { rows[i] };
+        rec.ip      = "196.1.228.69";
+        rec.barcode = "23333004837993";
+        rec.session = "UBBB92AYNbB1Ocf";
+        rec.date    = {{'2', '0', '2', '6', '-', '0', '3', '-', '0', '5', ' ',
+                        '1', '3', ':', '4', '7', ':', '4', '5'}};
+        rec.epoch   = 1772736465 + static_cast<int64_t>(i / 3);
+        rec.fullurl = i % 1000 == 0 ? ESCAPED_URL : FULL_URLS[i % std::size(FULL_URLS)];
+        // the host, between "//" and ':'
+        const auto host { rec.fullurl.find("//") + 2 };
+        rec.url     = rec.fullurl.substr(host, rec.fullurl.find(':', host) - host);
+    }
+    return rows;
+}
+
+template <typename F>
+double time_per_row(F&& write) {
+    const auto start { std::chrono::steady_clock::now() };
+    write();
+    const std::chrono::duration<double, std::nano> took {
+            std::chrono::steady_clock::now() - start };
+    return took.count() / static_cast<double>(ROWS);
+}
+
+} // namespace
+
+int main() {
+    const auto rows { make_rows() };
+
+    const auto print_ns { time_per_row([&] {
+        FILE* out { fopen("/dev/null", "w") };
+        for (const auto& rec : rows)
+            fmt::print(out, "{}\t{}\t{}\t{}\t{}\t{}\t{}\n", rec.ip, rec.barcode,
+                       rec.session, rec.date_view(), rec.epoch, rec.url, rec.fullurl);
+        fclose(out);
+    }) };
+    const auto writer_ns { time_per_row([&] {
+        FdSink sink {"/dev/null"};
+        TsvWriter out {sink, 8 << 20};
+        for (const auto& rec : rows)
+            out.row(rec, rec.url);
+        out.finish();
+        sink.finish();
+    }) };
+    fmt::print("fmt::print {:6.1f} ns/row   TsvWriter {:6.1f} ns/row   {:4.1f}x\n",
+               print_ns, writer_ns, print_ns / writer_ns);
+}
@@ -0,0 +1,165 @@
+// bgzf-compress: rewrites a finished text data set (step 2's CSV) as
+// block gzip, with the same block index step 1's --bgzf writes, so the
+// yearly file can be read in parallel or from the middle too
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <getopt.h>
+
+#include <fmt/core.h>
+
+#include "bgzf.h"
+#include "mapped_file.h"
+#include "output.h"
+
+namespace {
+
+[[noreturn]] void usage(const char* progname, int status) {
+    auto& out { status == 0 ? std::cout : std::cerr };
+    out << "usage: " << progname << " [options] FILE\n"
+        << "\n"
+        << "writes FILE as block gzip to FILE.gz, and its block index to\n"
+        << "FILE.gz.idx\n"
+        << "\n"
+        << "  -z, --level LEVEL    gzip level (1-9, default: 6)\n"
+        << "  -t, --threads N      compress on N threads (default: every core)\n"
+        << "  -k, --key COLUMN     the column whose range goes in the index\n"
+        << "                       (default: date_and_time)\n"
+        << "  -s, --sep CHAR       the field separator (default: ,)\n"
+        << "  -h, --help           show this message\n";
+    std::exit(status);
+}
+
+size_t parse_number(const char* progname, const char* arg, size_t max) {
+    size_t value {0};
+    for (const char* c = arg; *c != '\0'; ++c) {
+        if (*c < '0' || *c > '9' || value > max)
+            usage(progname, 1);
+        value = value * 10 + static_cast<size_t>(*c - '0');
+    }
+    if (value == 0 || value > max)
+        usage(progname, 1);
+    return value;
+}
+
+// the `column`th field of `line` (quotes stripped from a quoted one,
+// which can hold separators: fwrite quotes those), or an empty view if
+// the line is shorter
+std::string_view field(std::string_view line, size_t column, char sep) {
+    size_t start {0};
+    for (size_t i = 0;; ++i) {
+        size_t end { start };
+        const bool quoted { end < line.size() && line[end] == '"' };
+        if (quoted) {
+            // to the closing quote; a doubled one is part of the field
+            for (++end; end < line.size(); ++end) {
+                if (line[end] != '"')
+                    continue;
+                if (end + 1 < line.size() && line[end + 1] == '"')
+                    ++end;
+                else
+                    break;
+            }
+        }
+        end = std::min(line.find(sep, end), line.size());
+        if (i == column) {
+            auto value { line.substr(start, end - start) };
+            if (quoted && value.size() >= 2 && value.back() == '"')
+                value = value.substr(1, value.size() - 2);
+            return value;
+        }
+        if (end == line.size())
+            return {};
+        start = end + 1;
+    }
+}
+
+// which field of `header` is named `key`
+size_t find_column(std::string_view header, const std::string& key, char sep) {
+    for (size_t i = 0;; ++i) {
+        const auto name { field(header, i, sep) };
+        if (name == key)
+            return i;
+        if (name.data() + name.size() >= header.data() + header.size())
+            throw std::runtime_error {fmt::format("no column named {}", key)};
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    static const option long_options[] {
+        {"level",   required_argument, nullptr, 'z'},
+        {"threads", required_argument, nullptr, 't'},
+        {"key",     required_argument, nullptr, 'k'},
+        {"sep",     required_argument, nullptr, 's'},
+        {"help",    no_argument,       nullptr, 'h'},
+        {nullptr,   0,                 nullptr, 0}
+    };
+
+    int level      {6};
+    size_t threads { std::max(1U, std::thread::hardware_concurrency()) };
+    std::string key {"date_and_time"};
+    char sep       {','};
+    int c {0};
+    while ((c = getopt_long(argc, argv, "z:t:k:s:h", long_options, nullptr)) != -1) {
+        switch (c) {
+            case 'z': level   = static_cast<int>(parse_number(argv[0], optarg, 9)); break;
+            case 't': threads = parse_number(argv[0], optarg, 1024); break;
+            case 'k': key     = optarg; break;
+            case 's':
+                if (strlen(optarg) != 1)
+                    usage(argv[0], 1);
+                sep = optarg[0];
+                break;
+            case 'h': usage(argv[0], 0);
+            default:  usage(argv[0], 1);
+        }
+    }
+    if (optind + 1 != argc)
+        usage(argv[0], 1);
+    const std::string path {argv[optind]};
+
+    try {
+        const MappedFile input {path};
+        auto rest { input.view() };
+        if (rest.empty())
+            throw std::runtime_error {fmt::format("{} is empty", path)};
+
+        FdSink sink {path + ".gz"};
+        BgzfWriter out {sink, path + ".gz.idx", level, threads};
+
+        // a line, with its newline if it has one
+        const auto next_line = [&rest] {
+            const auto nl { rest.find('\n') };
+            const auto line { rest.substr(0, nl == std::string_view::npos ? nl : nl + 1) };
+            rest.remove_prefix(line.size());
+            return line;
+        };
+        const auto header { next_line() };
+        const auto column { find_column(header.substr(0, header.find_last_not_of("\r\n") + 1),
+                                        key, sep) };
+        out.text(header);
+        std::string last {};
+        while (!rest.empty()) {
+            auto line { next_line() };
+            if (line.back() != '\n') {
+                last = fmt::format("{}\n", line);
+                line = last;
+            }
+            out.line(line, field(line.substr(0, line.find_last_not_of("\r\n") + 1),
+                                 column, sep));
+        }
+        out.finish();
+        sink.finish();
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "bgzf.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/core.h>
+#include <zlib.h>
+
+namespace {
+
+// uncompressed bytes per block; small enough that even incompressible
+// data (stored at level 0) fits the 64 KiB limit on a whole block
+constexpr size_t BLOCK_DATA_SIZE {0xff00};
+constexpr size_t MAX_BLOCK_SIZE  {0x10000};
+
+constexpr size_t HEADER_SIZE  {18};
+constexpr size_t TRAILER_SIZE {8};
+
+// gzip header with a BC extra field whose BSIZE (bytes 16-17, the
+// total block size minus one) is filled in per block
+constexpr std::array<unsigned char, HEADER_SIZE> BLOCK_HEADER {{
+    0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0
+}};
+
+constexpr std::array<unsigned char, 28> EOF_BLOCK {{
+    0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+    0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+}};
+
+void put_le(char* out, uint32_t value, size_t bytes) noexcept {
+    for (size_t i = 0; i < bytes; ++i)
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+// raw-deflates `raw` into a whole BGZF block; returns false if the
+// result doesn't fit in a block
+bool deflate_block(z_stream& zs, int level, const std::string& raw,
+                   std::string& block) {
+    block.resize(MAX_BLOCK_SIZE);
+    deflateReset(&zs);
+    deflateParams(&zs, level, Z_DEFAULT_STRATEGY);
+    zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(raw.data()));
+    zs.avail_in  = static_cast<uInt>(raw.size());
+    zs.next_out  = reinterpret_cast<Bytef*>(block.data() + HEADER_SIZE);
+    zs.avail_out = static_cast<uInt>(MAX_BLOCK_SIZE - HEADER_SIZE - TRAILER_SIZE);
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+        return false;
+
+    const auto size { HEADER_SIZE + zs.total_out + TRAILER_SIZE };
+    memcpy(block.data(), BLOCK_HEADER.data(), HEADER_SIZE);
+    put_le(block.data() + 16, static_cast<uint32_t>(size - 1), 2);
+    const auto crc { crc32(0, reinterpret_cast<const Bytef*>(raw.data()),
+                           static_cast<uInt>(raw.size())) };
+    put_le(block.data() + HEADER_SIZE + zs.total_out,
+           static_cast<uint32_t>(crc), 4);
+    put_le(block.data() + HEADER_SIZE + zs.total_out + 4,
+           static_cast<uint32_t>(raw.size()), 4);
+    block.resize(size);
+    return true;
+}
+
+} // namespace
+
+BgzfWriter::Block::Block()                                = default;
+BgzfWriter::Block::Block(Block&&) noexcept                = default;
+BgzfWriter::Block& BgzfWriter::Block::operator=(Block&&) noexcept = default;
+BgzfWriter::Block::~Block()                               = default;
+
+BgzfWriter::BgzfWriter(OutputSink& sink, std::string index_path, int level,
+                       size_t threads)
+    : sink_ {&sink}, index_path_ {std::move(index_path)}, level_ {level},
+      max_in_flight_ {4 * threads} {
+    current_.raw.reserve(BLOCK_DATA_SIZE);
+    index_ = "block\tcoffset\tuoffset\tfirst_row\trows\tmin_date\tmax_date\n";
+    streams_ = std::make_unique<z_stream[]>(threads);
+    for (size_t t = 0; t < threads; ++t) {
+        if (deflateInit2(&streams_[t], level_, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            for (size_t i = 0; i < t; ++i)
+                deflateEnd(&streams_[i]);
+            throw std::runtime_error {"couldn't initialize zlib"};
+        }
+    }
+    for (size_t t = 0; t < threads; ++t)
+        pool_.emplace_back([this, t] { compress_blocks(streams_[t]); });
+}
+
+BgzfWriter::~BgzfWriter() {
+    {
+        const std::lock_guard lock {mtx_};
+        stop_ = true;
+    }
+    change_.notify_all();
+}
+
+void BgzfWriter::compress_blocks(z_stream& zs) {
+    std::unique_lock lock {mtx_};
+    for (;;) {
+        change_.wait(lock, [&] { return stop_ || next_seq_ < sealed_; });
+        if (next_seq_ >= sealed_)
+            break;
+        auto& block { in_flight_[next_seq_++ - first_seq_] };
+        lock.unlock();
+        // deque references survive pushes at the back and pops of
+        // other elements at the front, so `block` stays put
+        if (!deflate_block(zs, level_, block.raw, block.compressed))
+            deflate_block(zs, 0, block.raw, block.compressed);
+        lock.lock();
+        block.done = true;
+        change_.notify_all();
+    }
+    deflateEnd(&zs);
+}
+
+void BgzfWriter::write_done_blocks(std::unique_lock<std::mutex>& lock) {
+    while (!in_flight_.empty() && in_flight_.front().done) {
+        auto block { std::move(in_flight_.front()) };
+        in_flight_.pop_front();
+        ++first_seq_;
+        lock.unlock();
+        sink_->write(block.compressed);
+        if (block.rows > 0)
+            index_ += fmt::format("{}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+                                  first_seq_ - 1, coffset_, uoffset_,
+                                  block.first_row, block.rows,
+                                  block.min_date, block.max_date);
+        coffset_ += block.compressed.size();
+        uoffset_ += block.raw.size();
+        lock.lock();
+    }
+}
+
+void BgzfWriter::seal() {
+    if (current_.raw.empty())
+        return;
+    Block next {};
+    next.raw.reserve(BLOCK_DATA_SIZE);
+    next.first_row = rows_;
+
+    std::unique_lock lock {mtx_};
+    in_flight_.push_back(std::move(current_));
+    ++sealed_;
+    change_.notify_all();
+    write_done_blocks(lock);
+    // don't run too far ahead of the compressors
+    while (in_flight_.size() > max_in_flight_) {
+        change_.wait(lock, [&] { return in_flight_.front().done; });
+        write_done_blocks(lock);
+    }
+    lock.unlock();
+    current_ = std::move(next);
+}
+
+void BgzfWriter::append(const char* data, size_t size) {
+    while (size > 0) {
+        const auto room { BLOCK_DATA_SIZE - current_.raw.size() };
+        const auto take { std::min(room, size) };
+        current_.raw.append(data, take);
+        data += take;
+        size -= take;
+        if (current_.raw.size() == BLOCK_DATA_SIZE)
+            seal();
+    }
+}
+
+void BgzfWriter::header() {
+    text(TSV_HEADER);
+}
+
+void BgzfWriter::text(std::string_view bytes) {
+    append(bytes.data(), bytes.size());
+}
+
+void BgzfWriter::row(const LogRecord& rec, std::string_view url) {
+    const auto max_size { max_row_size(rec, url) };
+    if (row_buf_size_ < max_size) {
+        row_buf_.reset(new char[max_size]);
+        row_buf_size_ = max_size;
+    }
+    const auto size { static_cast<size_t>(
+            serialize_row(row_buf_.get(), rec, url, escaped_) - row_buf_.get()) };
+    line({row_buf_.get(), size}, rec.date_view());
+}
+
+void BgzfWriter::line(std::string_view bytes, std::string_view date) {
+    if (current_.raw.size() + bytes.size() > BLOCK_DATA_SIZE)
+        seal();
+
+    if (current_.rows == 0) {
+        current_.first_row = rows_;
+        current_.min_date  = date;
+        current_.max_date  = date;
+    } else if (date < current_.min_date) {
+        current_.min_date = date;
+    } else if (date > current_.max_date) {
+        current_.max_date = date;
+    }
+    ++current_.rows;
+    ++rows_;
+    append(bytes.data(), bytes.size());
+}
+
+void BgzfWriter::flush() {
+    seal();
+    {
+        std::unique_lock lock {mtx_};
+        while (!in_flight_.empty()) {
+            change_.wait(lock, [&] { return in_flight_.front().done; });
+            write_done_blocks(lock);
+        }
+    }
+}
+
+void BgzfWriter::finish() {
+    flush();
+    sink_->write({reinterpret_cast<const char*>(EOF_BLOCK.data()), EOF_BLOCK.size()});
+    coffset_ += EOF_BLOCK.size();
+
+    if (index_path_.empty())
+        return;
+    FdSink index {index_path_};
+    index.write(index_);
+    index.finish();
+}
@@ -0,0 +1,173 @@
+#include "decompress.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+#include <zlib.h>
+
+#include "mapped_file.h"
+
+namespace {
+
+// a buffer that doubles when it fills up
+struct GrowingBuffer {
+    explicit GrowingBuffer(size_t initial)
+        : data {new char[initial]}, capacity {initial} {}
+
+    char* end() noexcept { return data.get() + size; }
+    size_t room() const noexcept { return capacity - size; }
+
+    void grow() {
+        std::unique_ptr<char[]> bigger {new char[2 * capacity]};
+        memcpy(bigger.get(), data.get(), size);
+        data = std::move(bigger);
+        capacity *= 2;
+    }
+
+    std::unique_ptr<char[]> data {};
+    size_t size                  {0};
+    size_t capacity              {0};
+};
+
+bool ends_with(std::string_view path, std::string_view suffix) noexcept {
+    return path.size() >= suffix.size() &&
+           path.substr(path.size() - suffix.size()) == suffix;
+}
+
+// logs compress about 5:1; this is only where the buffer starts
+constexpr size_t EXPECTED_RATIO {6};
+// inflate's avail_in/avail_out are 32 bits
+constexpr size_t MAX_ZLIB_CHUNK {1u << 30};
+
+std::unique_ptr<char[]> inflate_file(const std::string& path, size_t& size) {
+    const MappedFile mapping {path};
+    const auto input { mapping.view() };
+    // a gzip member ends with its uncompressed size (mod 2^32): for the
+    // usual single-member file, the exact size of the output
+    size_t hint { EXPECTED_RATIO * input.size() };
+    if (input.size() >= 18) {
+        uint32_t isize {0};
+        memcpy(&isize, input.data() + input.size() - 4, 4);
+        hint = std::max<size_t>(hint / EXPECTED_RATIO, isize) + 1;
+    }
+    GrowingBuffer out {std::max<size_t>(hint, 4096)};
+
+    z_stream zs {};
+    // 15 + 32: a gzip or zlib header, detected automatically
+    if (inflateInit2(&zs, 15 + 32) != Z_OK)
+        throw std::runtime_error {"couldn't initialize zlib"};
+    size_t consumed {0};
+    bool finished   {false};
+    // inflate may hold back output after eating all of its input, so
+    // keep going until the last member has ended
+    while (consumed < input.size() || !finished) {
+        if (out.room() == 0)
+            out.grow();
+        const auto in_chunk  { std::min(input.size() - consumed, MAX_ZLIB_CHUNK) };
+        const auto out_chunk { std::min(out.room(), MAX_ZLIB_CHUNK) };
+        zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(input.data() + consumed));
+        zs.avail_in  = static_cast<uInt>(in_chunk);
+        zs.next_out  = reinterpret_cast<Bytef*>(out.end());
+        zs.avail_out = static_cast<uInt>(out_chunk);
+        const auto status { inflate(&zs, Z_NO_FLUSH) };
+        consumed += in_chunk - zs.avail_in;
+        out.size += out_chunk - zs.avail_out;
+        finished = status == Z_STREAM_END;
+        if (finished) {
+            // concatenated gzip files (and BGZF) are several members;
+            // zeros after the last one (a tape's or a preallocated
+            // file's padding) are no member, and gzip ignores them too
+            const auto rest { input.substr(consumed) };
+            if (std::all_of(rest.begin(), rest.end(), [](char c) { return c == '\0'; }))
+                break;
+            inflateReset(&zs);
+        } else if (status != Z_OK) {
+            inflateEnd(&zs);
+            // Z_BUF_ERROR: no progress possible, i.e. out of input
+            throw std::runtime_error {fmt::format(
+                    "{} is {}", path,
+                    status == Z_BUF_ERROR && consumed == input.size()
+                        ? "truncated" : "corrupt")};
+        }
+    }
+    inflateEnd(&zs);
+    size = out.size;
+    return std::move(out.data);
+}
+
+std::unique_ptr<char[]> unzstd_file(const std::string& path, size_t& size) {
+    pid_t pid {-1};
+    const auto fd { open_decompressor(path, pid) };
+    struct stat st{};
+    const auto compressed { stat(path.c_str(), &st) == 0
+                            ? static_cast<size_t>(st.st_size) : 0 };
+    GrowingBuffer out {std::max<size_t>(EXPECTED_RATIO * compressed, 4096)};
+    for (;;) {
+        if (out.room() == 0)
+            out.grow();
+        const auto nread { read(fd, out.end(), out.room()) };
+        if (nread == -1 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            break;
+        out.size += static_cast<size_t>(nread);
+    }
+    close(fd);
+    wait_decompressor(pid, path);
+    size = out.size;
+    return std::move(out.data);
+}
+
+} // namespace
+
+bool is_compressed(std::string_view path) noexcept {
+    return ends_with(path, ".gz") || ends_with(path, ".zst");
+}
+
+int open_decompressor(const std::string& path, pid_t& pid) {
+    int fds[2] {-1, -1};
+    if (pipe2(fds, O_CLOEXEC) == -1)
+        throw std::runtime_error {fmt::format("couldn't decompress {}", path)};
+
+    posix_spawn_file_actions_t actions {};
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    const std::string tool { ends_with(path, ".zst") ? "zstd" : "gzip" };
+    std::vector<std::string> argv { tool, "-d", "-c", "-q", "--", path };
+    std::vector<char*> args {};
+    for (auto& arg : argv)
+        args.push_back(arg.data());
+    args.push_back(nullptr);
+    const auto spawned { posix_spawnp(&pid, tool.c_str(), &actions, nullptr,
+                                      args.data(), environ) };
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (spawned != 0) {
+        close(fds[0]);
+        throw std::runtime_error {fmt::format("couldn't start {}: {}", tool,
+                                              strerror(spawned))};
+    }
+    return fds[0];
+}
+
+void wait_decompressor(pid_t pid, const std::string& path) {
+    int status {0};
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        throw std::runtime_error {fmt::format("couldn't decompress {}", path)};
+}
+
+std::unique_ptr<char[]> read_decompressed(const std::string& path, size_t& size) {
+    if (ends_with(path, ".zst"))
+        return unzstd_file(path, size);
+    return inflate_file(path, size);
+}
@@ -0,0 +1,171 @@
+#include "follow.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char DAILY_LOG[] {"i.ezproxy.nypl.org.[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9].log"};
+
+bool is_daily_log(const char* name) noexcept {
+    return fnmatch(DAILY_LOG, name, 0) == 0;
+}
+
+std::string directory_of(const std::string& path) {
+    const auto slash { path.rfind('/') };
+    if (slash == std::string::npos)
+        return ".";
+    return path.substr(0, slash);
+}
+
+} // namespace
+
+LogTail::LogTail(std::string path, size_t chunk_bytes)
+    : dir_ {directory_of(path)}, path_ {std::move(path)},
+      chunk_bytes_ {chunk_bytes} {
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ == -1)
+        throw std::runtime_error {fmt::format("couldn't start inotify: {}",
+                                              strerror(errno))};
+    // appends to any log, and new logs (created, or moved into place)
+    if (inotify_add_watch(inotify_, dir_.c_str(),
+                          IN_MODIFY | IN_CREATE | IN_MOVED_TO) == -1) {
+        const auto error { errno };
+        // the destructor won't run for a half-built LogTail
+        close(inotify_);
+        throw std::runtime_error {fmt::format("couldn't watch {}: {}", dir_,
+                                              strerror(error))};
+    }
+    open_current();
+}
+
+LogTail::~LogTail() {
+    if (fd_ != -1)
+        close(fd_);
+    if (inotify_ != -1)
+        close(inotify_);
+}
+
+void LogTail::open_current() {
+    if (fd_ != -1)
+        close(fd_);
+    fd_     = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    offset_ = 0;
+}
+
+// the log for the next day after ours, if it exists yet ("" if not)
+std::string LogTail::next_log() {
+    if (!check_next_)
+        return {};
+    check_next_ = false;
+    const auto current { fs::path(path_).filename().string() };
+    std::string next {};
+    std::error_code error {};
+    for (const auto& entry : fs::directory_iterator(dir_, error)) {
+        const auto name { entry.path().filename().string() };
+        if (is_daily_log(name.c_str()) && name > current &&
+            (next.empty() || name < next))
+            next = name;
+    }
+    if (next.empty())
+        return {};
+    return (fs::path(dir_) / next).string();
+}
+
+// the complete lines from `offset_` on (at most `chunk_bytes_` of them,
+// unless one line is longer); with `whole`, a last line without a
+// newline counts as complete
+bool LogTail::read_lines(std::unique_ptr<char[]>& buffer, size_t& size, bool whole) {
+    if (fd_ == -1) {
+        open_current();
+        if (fd_ == -1)
+            return false;
+    }
+    struct stat st{};
+    if (fstat(fd_, &st) == -1)
+        throw std::runtime_error {fmt::format("couldn't stat {}", path_)};
+    const auto file_size { static_cast<size_t>(st.st_size) };
+    // truncated under us (copytruncate): start over
+    if (file_size < offset_)
+        offset_ = 0;
+
+    size_t want { std::min(file_size - offset_, chunk_bytes_) };
+    while (want > 0) {
+        buffer.reset(new char[want]);
+        size = 0;
+        while (size < want) {
+            const auto nread { pread(fd_, buffer.get() + size, want - size,
+                                     static_cast<off_t>(offset_ + size)) };
+            if (nread == -1 && errno == EINTR)
+                continue;
+            if (nread <= 0)
+                break;
+            size += static_cast<size_t>(nread);
+        }
+        const auto* last { static_cast<const char*>(memrchr(buffer.get(), '\n', size)) };
+        if (last != nullptr) {
+            size = static_cast<size_t>(last - buffer.get()) + 1;
+            offset_ += size;
+            return true;
+        }
+        if (offset_ + size >= file_size) {
+            // the partial line at the end
+            if (!whole || size == 0)
+                return false;
+            offset_ += size;
+            return true;
+        }
+        // a line longer than a chunk
+        want = std::min(file_size - offset_, 2 * want);
+    }
+    return false;
+}
+
+bool LogTail::next(std::unique_ptr<char[]>& buffer, size_t& size, int timeout_ms) {
+    for (;;) {
+        if (read_lines(buffer, size, false))
+            return true;
+        // nothing more in our log; if tomorrow's has started, ours is
+        // finished: hand out its last line, newline or not, then switch
+        const auto next { next_log() };
+        if (!next.empty()) {
+            if (read_lines(buffer, size, true)) {
+                // come back for the new log next time
+                check_next_ = true;
+                return true;
+            }
+            path_ = next;
+            open_current();
+            continue;
+        }
+
+        pollfd wait_for { inotify_, POLLIN, 0 };
+        const auto ready { poll(&wait_for, 1, timeout_ms) };
+        if (ready <= 0)
+            return false;
+        // drain the events; a new daily log means we might rotate
+        alignas(inotify_event) char events[4096];
+        ssize_t got {0};
+        while ((got = read(inotify_, events, sizeof(events))) > 0) {
+            for (ssize_t at = 0; at < got;) {
+                const auto* event { reinterpret_cast<const inotify_event*>(events + at) };
+                if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && event->len > 0 &&
+                    is_daily_log(event->name))
+                    check_next_ = true;
+                at += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+    }
+}
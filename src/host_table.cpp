@@ -0,0 +1,64 @@
+#include "host_table.h"
+
+#include <fmt/core.h>
+
+#include "output.h"
+
+namespace {
+
+// FNV-1a; hosts are short, and this is only hit once per row
+uint32_t hash_host(std::string_view host) noexcept {
+    uint32_t hash {2166136261U};
+    for (const char c : host) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+constexpr size_t INITIAL_SLOTS {4096};
+
+} // namespace
+
+HostTable::HostTable() {
+    slots_.resize(INITIAL_SLOTS);
+}
+
+uint32_t HostTable::intern(std::string_view host) {
+    const auto hash { hash_host(host) };
+    const auto mask { slots_.size() - 1 };
+    for (auto i = hash & mask; ; i = (i + 1) & mask) {
+        auto& slot { slots_[i] };
+        if (slot.id == 0) {
+            const auto id { static_cast<uint32_t>(hosts_.size()) };
+            hosts_.emplace_back(host);
+            slot = {hash, id + 1};
+            // keep the table at most half full
+            if (hosts_.size() * 2 > slots_.size())
+                grow();
+            return id;
+        }
+        if (slot.hash == hash && hosts_[slot.id - 1] == host)
+            return slot.id - 1;
+    }
+}
+
+void HostTable::grow() {
+    std::vector<Slot> old (slots_.size() * 2);
+    old.swap(slots_);
+    const auto mask { slots_.size() - 1 };
+    for (const auto& slot : old) {
+        if (slot.id == 0)
+            continue;
+        auto i { slot.hash & mask };
+        while (slots_[i].id != 0)
+            i = (i + 1) & mask;
+        slots_[i] = slot;
+    }
+}
+
+void HostTable::write(FILE* out) const {
+    fmt::print(out, "{}\t{}\n", "id", "url");
+    for (size_t id = 0; id < hosts_.size(); ++id)
+        fmt::print(out, "{}\t{}\n", id, escape_field(hosts_[id]));
+}
@@ -0,0 +1,90 @@
+#include "ip_address.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <arpa/inet.h>
+
+namespace {
+
+// the 12 bytes in front of every IPv4-mapped address
+constexpr std::array<uint8_t, 12> V4_MAPPED_PREFIX {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff}};
+
+// "a.b.c.d" into the last four bytes of `address`; false if it isn't
+// exactly four decimal octets
+bool parse_v4(std::string_view text, IpAddress& address) noexcept {
+    size_t i {0};
+    for (size_t octet = 0; octet < 4; ++octet) {
+        if (octet > 0) {
+            if (i >= text.size() || text[i] != '.')
+                return false;
+            ++i;
+        }
+        unsigned value  {0};
+        size_t digits   {0};
+        for (; i < text.size() && digits < 4; ++i, ++digits) {
+            const auto d { static_cast<unsigned>(text[i] - '0') };
+            if (d > 9)
+                break;
+            value = value * 10 + d;
+        }
+        if (digits == 0 || digits > 3 || value > 255)
+            return false;
+        address.bytes[12 + octet] = static_cast<uint8_t>(value);
+    }
+    if (i != text.size())
+        return false;
+    std::copy(V4_MAPPED_PREFIX.begin(), V4_MAPPED_PREFIX.end(), address.bytes.begin());
+    return true;
+}
+
+} // namespace
+
+bool IpAddress::empty() const noexcept {
+    return std::all_of(bytes.begin(), bytes.end(), [](uint8_t b) { return b == 0; });
+}
+
+bool IpAddress::is_v4() const noexcept {
+    return std::equal(V4_MAPPED_PREFIX.begin(), V4_MAPPED_PREFIX.end(), bytes.begin());
+}
+
+IpAddress parse_ip(std::string_view text) noexcept {
+    IpAddress address {};
+    if (text.find(':') == std::string_view::npos) {
+        if (!parse_v4(text, address))
+            address = {};
+        return address;
+    }
+    // inet_pton wants a C string
+    char buffer[MAX_IP_TEXT + 1] {};
+    if (text.size() > MAX_IP_TEXT)
+        return address;
+    memcpy(buffer, text.data(), text.size());
+    if (inet_pton(AF_INET6, buffer, address.bytes.data()) != 1)
+        address = {};
+    return address;
+}
+
+void truncate_ip(IpAddress& address) noexcept {
+    // the mapping prefix and three octets, or three 16-bit groups
+    const ptrdiff_t keep { address.is_v4() ? 15 : 6 };
+    std::fill(address.bytes.begin() + keep, address.bytes.end(), 0);
+}
+
+char* format_ip(char* out, const IpAddress& address) noexcept {
+    if (address.empty())
+        return out;
+    if (address.is_v4()) {
+        for (size_t i = 12; i < 16; ++i) {
+            if (i > 12)
+                *out++ = '.';
+            out = std::to_chars(out, out + 3, address.bytes[i]).ptr;
+        }
+        return out;
+    }
+    char buffer[INET6_ADDRSTRLEN] {};
+    inet_ntop(AF_INET6, address.bytes.data(), buffer, sizeof(buffer));
+    const auto size { strlen(buffer) };
+    memcpy(out, buffer, size);
+    return out + size;
+}
@@ -0,0 +1,93 @@
+#include "line_filter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "timestamp.h"
+
+FilterCounts& FilterCounts::operator+=(const FilterCounts& other) noexcept {
+    no_barcode    += other.no_barcode;
+    excluded_host += other.excluded_host;
+    outside_dates += other.outside_dates;
+    return *this;
+}
+
+size_t FilterCounts::total() const noexcept {
+    return no_barcode + excluded_host + outside_dates;
+}
+
+LineFilter::LineFilter(const FieldLayout& layout, const FilterRules& rules)
+    : rules_ {&rules},
+      rejected_ {rules.tally_dropped ? Verdict::TALLY : Verdict::DROP} {
+    predicates_[count_++] = {layout.user, Check::BARCODE};
+    if (!rules.excluded_hosts.empty() && layout.host != NO_FIELD)
+        predicates_[count_++] = {layout.host, Check::HOST};
+    if (rules.first_day > 0 || rules.last_day < INT32_MAX)
+        predicates_[count_++] = {layout.time, Check::DATE};
+    std::sort(predicates_.begin(), predicates_.begin() + static_cast<ptrdiff_t>(count_),
+              [](const Predicate& a, const Predicate& b) { return a.field < b.field; });
+}
+
+bool LineFilter::rejects(const Predicate& predicate, std::string_view field,
+                         FilterCounts& counts) const noexcept {
+    switch (predicate.check) {
+        case Check::BARCODE:
+            if (field != "-")
+                return false;
+            ++counts.no_barcode;
+            return true;
+        case Check::HOST:
+            if (!std::binary_search(rules_->excluded_hosts.begin(),
+                                    rules_->excluded_hosts.end(), field, std::less<>{}))
+                return false;
+            ++counts.excluded_host;
+            return true;
+        case Check::DATE: {
+            // a date we can't read is left for the full parse
+            const auto day { raw_day(field) };
+            if (day == 0 || (day >= rules_->first_day && day <= rules_->last_day))
+                return false;
+            ++counts.outside_dates;
+            return true;
+        }
+    }
+    return false;
+}
+
+LineFilter::Verdict LineFilter::check(std::string_view line,
+                                      FilterCounts& counts) const noexcept {
+    const char* const begin { line.data() };
+    const char* const end   { begin + line.size() };
+    const auto* quote { static_cast<const char*>(memchr(begin, '"', line.size())) };
+    const char* const split_end { quote == nullptr ? end : quote };
+
+    // the start of field `field`
+    const char* start { begin };
+    size_t field      {0};
+    for (size_t i = 0; i < count_; ++i) {
+        const auto& predicate { predicates_[i] };
+        for (; field < predicate.field; ++field) {
+            const auto* space { static_cast<const char*>(
+                    memchr(start, ' ', static_cast<size_t>(split_end - start))) };
+            if (space == nullptr)
+                return quote == nullptr ? Verdict::KEEP : Verdict::LEX;
+            start = space + 1;
+        }
+        const auto* space { static_cast<const char*>(
+                memchr(start, ' ', static_cast<size_t>(split_end - start))) };
+        if (space == nullptr && quote != nullptr)
+            return Verdict::LEX;
+        const char* const stop { space == nullptr ? end : space };
+        if (rejects(predicate, {start, static_cast<size_t>(stop - start)}, counts))
+            return rejected_;
+    }
+    return Verdict::KEEP;
+}
+
+LineFilter::Verdict LineFilter::check(const std::string_view* fields,
+                                      FilterCounts& counts) const noexcept {
+    for (size_t i = 0; i < count_; ++i)
+        if (rejects(predicates_[i], fields[predicates_[i].field], counts))
+            return rejected_;
+    return Verdict::KEEP;
+}
@@ -0,0 +1,64 @@
+#include "log_format.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include "tokenize.h"
+
+namespace {
+
+void set_field(size_t& field, size_t index, std::string_view directive) {
+    if (field != NO_FIELD)
+        throw std::runtime_error {fmt::format("{} appears twice in the log format",
+                                              directive)};
+    field = index;
+}
+
+} // namespace
+
+LogFormat::LogFormat(std::string_view directive) : directive_ {directive} {
+    // the directive is split just like the lines it describes, so every
+    // directive lines up with the field it fills
+    std::string_view directives[MAX_FIELDS + 1] {};
+    const auto count { lex_fields(directive_, directives, MAX_FIELDS + 1) };
+    size_t index {0};
+    for (size_t i = 0; i < count; ++i, ++index) {
+        const auto d { directives[i] };
+        if (d == "%h" || d == "%a") {
+            set_field(layout_.host, index, d);
+        } else if (d == "%u") {
+            set_field(layout_.user, index, d);
+        } else if (d == "%{ezproxy-session}i") {
+            set_field(layout_.session, index, d);
+        } else if (d == "%t") {
+            set_field(layout_.time, index, d);
+            // and the offset
+            ++index;
+        } else if (d == "%r") {
+            // lex_fields strips quotes, so look at what's before it; an
+            // unquoted request would be three fields
+            if (d.data() == directive_.data() || d.data()[-1] != '"')
+                throw std::runtime_error {"%r has to be quoted in the log format"};
+            set_field(layout_.request, index, d);
+        } else if (d == "%s" || d == "%>s") {
+            set_field(layout_.status, index, d);
+        } else if (d == "%b" || d == "%B") {
+            set_field(layout_.bytes, index, d);
+        }
+    }
+    if (layout_.user == NO_FIELD || layout_.time == NO_FIELD || layout_.request == NO_FIELD)
+        throw std::runtime_error {"the log format needs %u, %t and \"%r\""};
+
+    size_t last {0};
+    for (const auto field : {layout_.host, layout_.user, layout_.session,
+                             layout_.time + 1, layout_.request, layout_.status,
+                             layout_.bytes})
+        if (field != NO_FIELD)
+            last = std::max(last, field);
+    layout_.fields = last + 1;
+    if (layout_.fields > MAX_FIELDS)
+        throw std::runtime_error {fmt::format("the fields the log format needs have to be "
+                                              "among its first {}", MAX_FIELDS)};
+}
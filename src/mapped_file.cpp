@@ -0,0 +1,59 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+namespace {
+
+int open_or_throw(const std::string& path) {
+    const auto fd { open(path.c_str(), O_RDONLY) };
+    if (fd == -1)
+        throw std::runtime_error {fmt::format("couldn't open {}", path)};
+    return fd;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    const auto fd { open_or_throw(path) };
+    struct stat st{};
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error {fmt::format("couldn't stat {}", path)};
+    }
+    map(fd, path, 0, static_cast<size_t>(st.st_size));
+}
+
+MappedFile::MappedFile(const std::string& path, size_t begin, size_t end) {
+    map(open_or_throw(path), path, begin, end);
+}
+
+void MappedFile::map(int fd, const std::string& path, size_t begin, size_t end) {
+    static const auto page_size { static_cast<size_t>(sysconf(_SC_PAGESIZE)) };
+    const auto offset { begin - begin % page_size };
+    skip_ = begin - offset;
+    size_ = end - offset;
+    // mmap refuses zero-length mappings; an empty log is just no lines
+    if (end <= begin) {
+        close(fd);
+        size_ = skip_ = 0;
+        return;
+    }
+    void* addr { mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd,
+                      static_cast<off_t>(offset)) };
+    close(fd);
+    if (addr == MAP_FAILED)
+        throw std::runtime_error {fmt::format("couldn't mmap {}", path)};
+    madvise(addr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(addr);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr)
+        munmap(const_cast<char*>(data_), size_);
+}
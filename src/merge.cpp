@@ -0,0 +1,79 @@
+#include "merge.h"
+
+namespace {
+
+std::future<Batch> parse_ahead(const std::string& path, const Task& task,
+                               const LogFormat& format, const FilterRules& rules,
+                               const ColumnRewrites& rewrites) {
+    return std::async(std::launch::async, [path, task, &format, &rules, rewrites] {
+        return parse_task(path, task, format, rules, rewrites);
+    });
+}
+
+} // namespace
+
+LogMerger::NodeLog::NodeLog()                                         = default;
+LogMerger::NodeLog::NodeLog(NodeLog&&) noexcept                       = default;
+LogMerger::NodeLog& LogMerger::NodeLog::operator=(NodeLog&&) noexcept = default;
+LogMerger::NodeLog::~NodeLog()                                        = default;
+
+LogMerger::LogMerger(const std::vector<std::string>& paths, size_t chunk_bytes,
+                     const LogFormat& format, const FilterRules& rules,
+                     const ColumnRewrites& rewrites)
+    : format_ {&format}, rules_ {&rules}, rewrites_ {rewrites} {
+    logs_.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        auto& log  { logs_[i] };
+        log.path   = paths[i];
+        log.chunks = plan_tasks({paths[i]}, chunk_bytes);
+        if (!log.chunks.empty())
+            log.ahead = parse_ahead(log.path, log.chunks[log.next_chunk++],
+                                    *format_, *rules_, rewrites_);
+    }
+}
+
+LogMerger::~LogMerger() = default;
+
+// moves `log` to its next row, parsing its next chunk if it has to;
+// false once it's out of rows
+bool LogMerger::advance(NodeLog& log) {
+    if (++log.row < log.batch.rows.size())
+        return true;
+    for (;;) {
+        if (!log.ahead.valid())
+            return false;
+        auto batch { log.ahead.get() };
+        rejected_ += batch.rejected;
+        tallied_.insert(tallied_.end(), batch.tallied.begin(), batch.tallied.end());
+        if (log.next_chunk < log.chunks.size())
+            log.ahead = parse_ahead(log.path, log.chunks[log.next_chunk++],
+                                    *format_, *rules_, rewrites_);
+        retired_.push_back(std::move(log.batch));
+        log.batch = std::move(batch);
+        log.row   = 0;
+        if (!log.batch.rows.empty())
+            return true;
+    }
+}
+
+const LogRecord* LogMerger::next() {
+    if (!started_) {
+        started_ = true;
+        for (size_t i = 0; i < logs_.size(); ++i) {
+            // `row` starts out one before the first row
+            logs_[i].row = static_cast<size_t>(-1);
+            if (advance(logs_[i]))
+                heads_.push({logs_[i].batch.rows[logs_[i].row].epoch, i});
+        }
+    } else {
+        auto& log { logs_[current_] };
+        if (advance(log))
+            heads_.push({log.batch.rows[log.row].epoch, current_});
+    }
+    if (heads_.empty())
+        return nullptr;
+    current_ = heads_.top().second;
+    heads_.pop();
+    const auto& log { logs_[current_] };
+    return &log.batch.rows[log.row];
+}
@@ -0,0 +1,258 @@
+#include "options.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <getopt.h>
+
+Options::Options()                                 = default;
+Options::Options(const Options&)                   = default;
+Options::Options(Options&&) noexcept               = default;
+Options& Options::operator=(const Options&)        = default;
+Options& Options::operator=(Options&&) noexcept    = default;
+Options::~Options()                                = default;
+
+namespace {
+
+[[noreturn]] void usage(const char* progname, int status) {
+    auto& out { status == 0 ? std::cout : std::cerr };
+    out << "usage: " << progname << " [options]\n"
+        << "\n"
+        << "  -t, --threads N      parse logs on N threads (default: 1, at\n"
+        << "                       most 4 per core)\n"
+        << "  -c, --chunk-size MB  with several threads, split logs bigger\n"
+        << "                       than this so they're parsed in parallel\n"
+        << "                       too, and with --pipe read this much at\n"
+        << "                       a time (default: 32)\n"
+        << "  -i, --host-ids       write host ids in the url column, and the\n"
+        << "                       id -> host dictionary to\n"
+        << "                       intermediate/cleaned-hosts-DATE.dat\n"
+        << "  -g, --gather         writev the full URLs straight from the\n"
+        << "                       input instead of copying them\n"
+        << "  -z, --zstd LEVEL     write the output zstd-compressed (.dat.zst)\n"
+        << "                       at LEVEL (1-22), on every core\n"
+        << "  -b, --bgzf LEVEL     write the output as block gzip (.dat.gz)\n"
+        << "                       at LEVEL (1-9), compressed on the parsing\n"
+        << "                       threads, with a block index (.dat.gz.idx)\n"
+        << "  -p, --pipe           read log lines from standard input and\n"
+        << "                       write the cleaned rows (in whichever\n"
+        << "                       format) to standard output\n"
+        << "  -a, --archive TAR    read the daily logs of any year straight\n"
+        << "                       out of TAR (.tar, .tar.gz, .tgz or\n"
+        << "                       .tar.zst) instead of logs/\n"
+        << "  -f, --follow         after the complete days, tail today's log\n"
+        << "                       (and then the next day's...) until ^C\n"
+        << "  -s, --stats          write requests, bytes and status classes\n"
+        << "                       per day and host to\n"
+        << "                       intermediate/cleaned-stats-DATE.dat,\n"
+        << "                       counting every line read, including the\n"
+        << "                       ones the rows leave out\n"
+        << "  -l, --log-format F   the LogFormat directive the logs were\n"
+        << "                       written with (default: EZproxy's\n"
+        << "                       " << EZPROXY_LOG_FORMAT << ")\n"
+        << "  -x, --exclude FILE   drop lines from the client hosts (%h)\n"
+        << "                       listed in FILE, one per line\n"
+        << "  -F, --from DATE      drop lines logged before DATE (YYYY-MM-DD)\n"
+        << "  -T, --to DATE        drop lines logged after DATE (YYYY-MM-DD)\n"
+        << "  -d, --decode COLS    percent-decode these columns (barcode,\n"
+        << "                       fullurl, or both, comma-separated)\n"
+        << "  -m, --truncate-ips   write only the network of each client\n"
+        << "                       address: its /24 (IPv4) or /48 (IPv6)\n"
+        << "  -h, --help           show this message\n";
+    std::exit(status);
+}
+
+// a positive number, up to `max`
+size_t parse_count(const char* progname, const char* arg, size_t max = SIZE_MAX) {
+    size_t value {0};
+    // stoul skips leading whitespace, and "-1" comes back as ULONG_MAX
+    if (arg[0] >= '0' && arg[0] <= '9') {
+        try {
+            size_t used {0};
+            value = std::stoul(arg, &used);
+            if (used != std::string{arg}.size())
+                value = 0;
+        } catch (const std::exception&) {
+            value = 0;
+        }
+    }
+    if (value == 0) {
+        std::cerr << progname << ": expected a positive number, got '"
+                  << arg << "'\n";
+        usage(progname, 1);
+    }
+    if (value > max) {
+        std::cerr << progname << ": expected at most " << max << ", got '"
+                  << arg << "'\n";
+        usage(progname, 1);
+    }
+    return value;
+}
+
+// more threads than this only add batches held in memory at once
+size_t max_threads() {
+    return 4 * std::max(1U, std::thread::hardware_concurrency());
+}
+
+int parse_level(const char* progname, const char* arg, const char* format,
+                size_t max) {
+    const auto level { parse_count(progname, arg) };
+    if (level > max) {
+        std::cerr << progname << ": " << format << " levels go up to "
+                  << max << "\n";
+        usage(progname, 1);
+    }
+    return static_cast<int>(level);
+}
+
+LogFormat parse_log_format(const char* progname, const char* arg) {
+    try {
+        return LogFormat {arg};
+    } catch (const std::exception& e) {
+        std::cerr << progname << ": " << e.what() << "\n";
+        usage(progname, 1);
+    }
+}
+
+// "YYYY-MM-DD" as the number yyyymmdd
+int32_t parse_day(const char* progname, const char* arg) {
+    const std::string date {arg};
+    const bool ok { date.size() == 10 && date[4] == '-' && date[7] == '-' &&
+                    std::all_of(date.begin(), date.end(), [](char c) {
+                        return c == '-' || (c >= '0' && c <= '9');
+                    }) };
+    if (!ok) {
+        std::cerr << progname << ": expected a date (YYYY-MM-DD), got '"
+                  << arg << "'\n";
+        usage(progname, 1);
+    }
+    return std::stoi(date.substr(0, 4) + date.substr(5, 2) + date.substr(8, 2));
+}
+
+// the hosts listed in `path`, one per line (blank lines and lines
+// starting with '#' are skipped), sorted
+std::vector<std::string> read_hosts(const char* progname, const char* path) {
+    std::ifstream in {path};
+    if (!in) {
+        std::cerr << progname << ": couldn't open " << path << "\n";
+        usage(progname, 1);
+    }
+    std::vector<std::string> hosts {};
+    for (std::string line {}; std::getline(in, line);) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (!line.empty() && line.front() != '#')
+            hosts.push_back(std::move(line));
+    }
+    std::sort(hosts.begin(), hosts.end());
+    hosts.erase(std::unique(hosts.begin(), hosts.end()), hosts.end());
+    return hosts;
+}
+
+// "barcode", "fullurl" or "barcode,fullurl", into `rewrites`
+void parse_columns(const char* progname, const char* arg, ColumnRewrites& rewrites) {
+    std::string_view rest {arg};
+    while (!rest.empty()) {
+        const auto comma { rest.find(',') };
+        const auto column { rest.substr(0, comma) };
+        if (column == "barcode") {
+            rewrites.decode_barcode = true;
+        } else if (column == "fullurl") {
+            rewrites.decode_fullurl = true;
+        } else {
+            std::cerr << progname << ": can't decode column '" << column
+                      << "' (only barcode and fullurl)\n";
+            usage(progname, 1);
+        }
+        rest.remove_prefix(comma == std::string_view::npos ? rest.size() : comma + 1);
+    }
+    if (!rewrites.decode_barcode && !rewrites.decode_fullurl)
+        usage(progname, 1);
+}
+
+} // namespace
+
+Options parse_args(int argc, char** argv) {
+    static const option long_options[] {
+        {"threads",    required_argument, nullptr, 't'},
+        {"chunk-size", required_argument, nullptr, 'c'},
+        {"host-ids",   no_argument,       nullptr, 'i'},
+        {"gather",     no_argument,       nullptr, 'g'},
+        {"zstd",       required_argument, nullptr, 'z'},
+        {"bgzf",       required_argument, nullptr, 'b'},
+        {"pipe",       no_argument,       nullptr, 'p'},
+        {"archive",    required_argument, nullptr, 'a'},
+        {"follow",     no_argument,       nullptr, 'f'},
+        {"stats",      no_argument,       nullptr, 's'},
+        {"log-format", required_argument, nullptr, 'l'},
+        {"exclude",    required_argument, nullptr, 'x'},
+        {"from",       required_argument, nullptr, 'F'},
+        {"to",         required_argument, nullptr, 'T'},
+        {"decode",     required_argument, nullptr, 'd'},
+        {"truncate-ips", no_argument,     nullptr, 'm'},
+        {"help",       no_argument,       nullptr, 'h'},
+        {nullptr,      0,                 nullptr, 0}
+    };
+
+    Options opts {};
+    int c {0};
+    while ((c = getopt_long(argc, argv, "t:c:igz:b:pa:fsl:x:F:T:d:mh", long_options, nullptr)) != -1) {
+        switch (c) {
+            case 't': opts.threads    = parse_count(argv[0], optarg, max_threads()); break;
+            case 'c': opts.chunk_size = parse_count(argv[0], optarg, SIZE_MAX >> 20) << 20; break;
+            case 'i': opts.host_ids   = true; break;
+            case 'g': opts.gather     = true; break;
+            case 'z': opts.zstd_level = parse_level(argv[0], optarg, "zstd", 22); break;
+            case 'b': opts.bgzf_level = parse_level(argv[0], optarg, "gzip", 9); break;
+            case 'p': opts.pipe       = true; break;
+            case 'a': opts.archive    = optarg; break;
+            case 'f': opts.follow     = true; break;
+            case 's': opts.stats      = true; break;
+            case 'l': opts.log_format = parse_log_format(argv[0], optarg); break;
+            case 'x': opts.filter.excluded_hosts = read_hosts(argv[0], optarg); break;
+            case 'F': opts.filter.first_day = parse_day(argv[0], optarg); break;
+            case 'T': opts.filter.last_day  = parse_day(argv[0], optarg); break;
+            case 'd': parse_columns(argv[0], optarg, opts.rewrites); break;
+            case 'm': opts.rewrites.truncate_ips = true; break;
+            case 'h': usage(argv[0], 0);
+            default:  usage(argv[0], 1);
+        }
+    }
+    if (optind != argc)
+        usage(argv[0], 1);
+    if (opts.filter.first_day > opts.filter.last_day) {
+        std::cerr << argv[0] << ": --from is after --to\n";
+        usage(argv[0], 1);
+    }
+    // BGZF blocks are cut from serialized rows, which --gather never makes
+    if (opts.bgzf_level > 0 && (opts.zstd_level > 0 || opts.gather)) {
+        std::cerr << argv[0] << ": --bgzf can't be combined with --zstd "
+                  << "or --gather\n";
+        usage(argv[0], 1);
+    }
+    if (opts.pipe && !opts.archive.empty()) {
+        std::cerr << argv[0] << ": --archive can't be combined with --pipe\n";
+        usage(argv[0], 1);
+    }
+    // the BGZF index and end-of-file block are only written at the end
+    if (opts.follow && (opts.pipe || !opts.archive.empty() || opts.bgzf_level > 0)) {
+        std::cerr << argv[0] << ": --follow can't be combined with --pipe, "
+                  << "--archive or --bgzf\n";
+        usage(argv[0], 1);
+    }
+    // there's no file to put the id -> host dictionary (or the stats)
+    // next to
+    if (opts.pipe && (opts.host_ids || opts.stats)) {
+        std::cerr << argv[0] << ": --host-ids and --stats can't be combined "
+                  << "with --pipe\n";
+        usage(argv[0], 1);
+    }
+    // the stats count every line that's read, rows or not
+    opts.filter.tally_dropped = opts.stats;
+    return opts;
+}
@@ -0,0 +1,475 @@
+#include "output.h"
+
+#include <cerrno>
+#include <csignal>
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#include <fmt/core.h>
+
+namespace {
+
+// writes all of `bytes` to `fd`; returns 0, or the errno it failed with
+int write_all(int fd, std::string_view bytes) noexcept {
+    while (!bytes.empty()) {
+        const auto written { ::write(fd, bytes.data(), bytes.size()) };
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        bytes.remove_prefix(static_cast<size_t>(written));
+    }
+    return 0;
+}
+
+// writes all of `pieces` to `fd`, in order, up to IOV_MAX at a time;
+// returns 0, or the errno it failed with
+int writev_all(int fd, std::span<const iovec> pieces) {
+    // writev may stop partway through a piece, so work on a copy we can
+    // advance
+    std::vector<iovec> rest (pieces.begin(), pieces.end());
+    size_t first {0};
+    while (first < rest.size()) {
+        const auto count { std::min<size_t>(rest.size() - first, IOV_MAX) };
+        auto written { writev(fd, rest.data() + first, static_cast<int>(count)) };
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        auto left { static_cast<size_t>(written) };
+        while (first < rest.size() && left >= rest[first].iov_len)
+            left -= rest[first++].iov_len;
+        if (left > 0) {
+            rest[first].iov_base = static_cast<char*>(rest[first].iov_base) + left;
+            rest[first].iov_len -= left;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+FdSink::FdSink(const std::string& path)
+    : fd_ {open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)},
+      path_ {path} {
+    if (fd_ == -1)
+        throw std::runtime_error {fmt::format("couldn't create {}", path)};
+}
+
+FdSink::FdSink(int fd, std::string name)
+    : fd_ {fd}, path_ {std::move(name)} {
+}
+
+FdSink::~FdSink() {
+    if (fd_ != -1)
+        close(fd_);
+}
+
+void FdSink::write(std::string_view bytes) {
+    if (const auto error { write_all(fd_, bytes) }; error != 0)
+        throw std::runtime_error {fmt::format("couldn't write to {}: {}",
+                                              path_, strerror(error))};
+}
+
+void OutputSink::write_gather(std::span<const iovec> pieces) {
+    for (const auto& piece : pieces)
+        write({static_cast<const char*>(piece.iov_base), piece.iov_len});
+}
+
+void FdSink::write_gather(std::span<const iovec> pieces) {
+    if (const auto error { writev_all(fd_, pieces) }; error != 0)
+        throw std::runtime_error {fmt::format("couldn't write to {}: {}",
+                                              path_, strerror(error))};
+}
+
+void FdSink::finish() {
+    if (close(fd_) == -1)
+        throw std::runtime_error {fmt::format("couldn't close {}", path_)};
+    fd_ = -1;
+}
+
+PipeSink::PipeSink(const std::vector<std::string>& argv)
+    : command_ {argv.at(0)} {
+    int fds[2] {-1, -1};
+    if (pipe2(fds, O_CLOEXEC) == -1)
+        throw std::runtime_error {fmt::format("couldn't start {}", command_)};
+
+    posix_spawn_file_actions_t actions {};
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    std::vector<char*> args {};
+    for (const auto& arg : argv)
+        args.push_back(const_cast<char*>(arg.c_str()));
+    args.push_back(nullptr);
+    const auto status { posix_spawnp(&pid_, command_.c_str(), &actions,
+                                     nullptr, args.data(), environ) };
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (status != 0) {
+        close(fds[1]);
+        throw std::runtime_error {fmt::format("couldn't start {}: {}",
+                                              command_, strerror(status))};
+    }
+    fd_ = fds[1];
+
+    // a child that dies early would otherwise take us with it (SIGPIPE)
+    // on the next write, leaving a truncated file and no message; ignored,
+    // the write fails with EPIPE instead. the child was started with the
+    // default, and it comes back when we're done
+    struct sigaction ignore {};
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &old_sigpipe_);
+}
+
+PipeSink::~PipeSink() {
+    if (pid_ != -1)
+        close_and_wait();
+    sigaction(SIGPIPE, &old_sigpipe_, nullptr);
+}
+
+void PipeSink::write(std::string_view bytes) {
+    if (const auto error { write_all(fd_, bytes) }; error != 0)
+        fail(error);
+}
+
+void PipeSink::write_gather(std::span<const iovec> pieces) {
+    if (const auto error { writev_all(fd_, pieces) }; error != 0)
+        fail(error);
+}
+
+void PipeSink::fail(int error) {
+    // EPIPE: the child is gone, and how it went is the useful part
+    const auto failure { error == EPIPE ? close_and_wait() : std::string {} };
+    throw std::runtime_error {fmt::format("couldn't write to {}: {}", command_,
+                                          failure.empty() ? strerror(error) : failure)};
+}
+
+void PipeSink::finish() {
+    if (const auto failure { close_and_wait() }; !failure.empty())
+        throw std::runtime_error {failure};
+}
+
+std::string PipeSink::close_and_wait() {
+    std::string failure {};
+    if (fd_ != -1 && close(fd_) == -1)
+        failure = fmt::format("couldn't close the pipe to {}: {}", command_, strerror(errno));
+    fd_ = -1;
+
+    int status {0};
+    pid_t waited {-1};
+    while ((waited = waitpid(pid_, &status, 0)) == -1 && errno == EINTR) {}
+    pid_ = -1;
+    if (waited == -1)
+        return fmt::format("couldn't wait for {}: {}", command_, strerror(errno));
+    if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+        return fmt::format("{} exited with status {}", command_, WEXITSTATUS(status));
+    if (WIFSIGNALED(status))
+        return fmt::format("{} was killed by signal {} ({})", command_,
+                           WTERMSIG(status), strsignal(WTERMSIG(status)));
+    return failure;
+}
+
+std::unique_ptr<OutputSink> make_zstd_sink(const std::string& path, int level) {
+    // -T0: one compression thread per core
+    std::vector<std::string> argv {
+        "zstd", "-q", "-f", "-T0", fmt::format("-{}", level),
+        level > 19 ? "--ultra" : "--no-progress"
+    };
+    if (path.empty()) {
+        argv.emplace_back("-c");
+    } else {
+        argv.emplace_back("-o");
+        argv.push_back(path);
+    }
+    return std::make_unique<PipeSink>(argv);
+}
+
+namespace {
+
+// the offset of the first byte at or after `from` in `value` that's
+// below 0x20 (a control character: tab, newline, NUL...), above 0x7f
+// (which has to be part of a valid UTF-8 sequence) or, if `percent`, a
+// '%', or its size if there isn't one; nearly every field is all
+// printable ASCII, so this is what has to be fast
+size_t find_unusual(std::string_view value, size_t from, bool percent) noexcept {
+    size_t i { from };
+#if defined(__x86_64__)
+    const __m128i limit { _mm_set1_epi8(0x1f) };
+    // without `percent`, a byte the first test catches anyway stands in
+    const __m128i also  { _mm_set1_epi8(percent ? '%' : 0x1f) };
+    for (; i + 16 <= value.size(); i += 16) {
+        const __m128i chunk { _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(value.data() + i)) };
+        // x <= 0x1f (unsigned) exactly when min(x, 0x1f) == x, and the
+        // bytes above 0x7f are the ones with their top bit set
+        const __m128i low { _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(chunk, limit), chunk),
+                                         _mm_cmpeq_epi8(chunk, also)) };
+        const auto mask { static_cast<unsigned>(_mm_movemask_epi8(low) |
+                                                _mm_movemask_epi8(chunk)) };
+        if (mask != 0)
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+#endif
+    for (; i < value.size(); ++i) {
+        const auto c { static_cast<unsigned char>(value[i]) };
+        if (c < 0x20 || c > 0x7f || (percent && c == '%'))
+            return i;
+    }
+    return value.size();
+}
+
+// how long the UTF-8 sequence at `i` (a byte above 0x7f) is, or 0 if it
+// isn't a valid one: no overlong encodings, surrogates, or code points
+// past U+10FFFF
+size_t utf8_sequence(std::string_view value, size_t i) noexcept {
+    const auto byte = [&](size_t k) {
+        return i + k < value.size() ? static_cast<unsigned char>(value[i + k]) : 0U;
+    };
+    const auto continuation = [](unsigned b) { return (b & 0xc0) == 0x80; };
+    const auto lead { byte(0) };
+    const auto second { byte(1) };
+    if (lead >= 0xc2 && lead <= 0xdf)
+        return continuation(second) ? 2 : 0;
+    if (lead >= 0xe0 && lead <= 0xef) {
+        // E0 can't be overlong, ED can't be a surrogate
+        const bool ok { lead == 0xe0 ? second >= 0xa0 && second <= 0xbf
+                      : lead == 0xed ? second >= 0x80 && second <= 0x9f
+                                     : continuation(second) };
+        return ok && continuation(byte(2)) ? 3 : 0;
+    }
+    if (lead >= 0xf0 && lead <= 0xf4) {
+        // F0 can't be overlong, F4 can't go past U+10FFFF
+        const bool ok { lead == 0xf0 ? second >= 0x90 && second <= 0xbf
+                      : lead == 0xf4 ? second >= 0x80 && second <= 0x8f
+                                     : continuation(second) };
+        return ok && continuation(byte(2)) && continuation(byte(3)) ? 4 : 0;
+    }
+    return 0;
+}
+
+char* put_escaped(char* out, unsigned char c) noexcept {
+    static constexpr char HEX[] {"0123456789ABCDEF"};
+    *out++ = '%';
+    *out++ = HEX[c >> 4];
+    *out++ = HEX[c & 0xf];
+    return out;
+}
+
+// copies `value` to `out`, escaping control characters, every byte
+// that isn't part of a valid UTF-8 sequence and, for a `decoded` field
+// (where a '%' no longer starts an escape of its own), every '%', and
+// counting the field in `escaped` if it had any of the first two;
+// returns the end of what it wrote
+char* put_field(char* out, std::string_view value, EscapeCounts& escaped,
+                bool decoded = false) noexcept {
+    size_t i { find_unusual(value, 0, decoded) };
+    memcpy(out, value.data(), i);
+    out += i;
+    if (i == value.size())
+        return out;
+
+    bool control {false};
+    bool invalid {false};
+    while (i < value.size()) {
+        const auto c { static_cast<unsigned char>(value[i]) };
+        if (c < 0x20) {
+            out = put_escaped(out, c);
+            control = true;
+            ++i;
+        } else if (c < 0x80) {
+            // a decoded field's '%'
+            out = put_escaped(out, c);
+            ++i;
+        } else if (const auto length { utf8_sequence(value, i) }; length > 0) {
+            memcpy(out, value.data() + i, length);
+            out += length;
+            i   += length;
+        } else {
+            out = put_escaped(out, c);
+            invalid = true;
+            ++i;
+        }
+        // and on to the next run of printable ASCII
+        const auto next { find_unusual(value, i, decoded) };
+        memcpy(out, value.data() + i, next - i);
+        out += next - i;
+        i = next;
+    }
+    escaped.control      += control;
+    escaped.invalid_utf8 += invalid;
+    return out;
+}
+
+// everything up to (and including) the tab before the full URL
+char* put_row_prefix(char* out, const LogRecord& rec, std::string_view url,
+                     EscapeCounts& escaped) noexcept {
+    // a parsed address is already plain ASCII
+    out = rec.address.empty() ? put_field(out, rec.ip, escaped)
+                              : format_ip(out, rec.address);
+    *out++ = '\t';
+    out = put_field(out, rec.barcode, escaped, rec.barcode_decoded);  *out++ = '\t';
+    out = put_field(out, rec.session, escaped);  *out++ = '\t';
+    memcpy(out, rec.date.data(), rec.date.size());
+    out += rec.date.size();                      *out++ = '\t';
+    // 20 digits is enough for any int64
+    out = std::to_chars(out, out + 20, rec.epoch).ptr;
+    *out++ = '\t';
+    out = put_field(out, url, escaped);          *out++ = '\t';
+    return out;
+}
+
+// every byte of a field could become three
+constexpr size_t ESCAPE_GROWTH {3};
+// the epoch, separators and newline
+constexpr size_t ROW_OVERHEAD {64};
+
+size_t max_prefix_size(const LogRecord& rec, std::string_view url) noexcept {
+    return ESCAPE_GROWTH * (rec.ip.size() + rec.barcode.size() +
+                            rec.session.size() + url.size()) +
+           MAX_IP_TEXT + rec.date.size() + ROW_OVERHEAD;
+}
+
+// GatherWriter's scratch buffer; rows with an enormous URL to escape go
+// through it in several flushes
+constexpr size_t SCRATCH_SIZE {1 << 20};
+
+} // namespace
+
+EscapeCounts EscapeCounts::operator-(const EscapeCounts& before) const noexcept {
+    return {control - before.control, invalid_utf8 - before.invalid_utf8};
+}
+
+std::string escape_field(std::string_view value) {
+    std::string escaped (ESCAPE_GROWTH * value.size(), '\0');
+    EscapeCounts ignored {};
+    escaped.resize(static_cast<size_t>(put_field(escaped.data(), value, ignored) -
+                                       escaped.data()));
+    return escaped;
+}
+
+size_t max_row_size(const LogRecord& rec, std::string_view url) noexcept {
+    return max_prefix_size(rec, url) + ESCAPE_GROWTH * rec.fullurl.size();
+}
+
+char* serialize_row(char* out, const LogRecord& rec, std::string_view url,
+                    EscapeCounts& escaped) noexcept {
+    out = put_row_prefix(out, rec, url, escaped);
+    out = put_field(out, rec.fullurl, escaped, rec.fullurl_decoded);
+    *out++ = '\n';
+    return out;
+}
+
+TsvWriter::TsvWriter(OutputSink& sink, size_t buffer_size)
+    : sink_ {&sink}, buffer_ {new char[buffer_size]}, capacity_ {buffer_size} {
+}
+
+void TsvWriter::reserve(size_t bytes) {
+    if (capacity_ - used_ >= bytes)
+        return;
+    flush();
+    // only a row bigger than the whole buffer gets here
+    if (capacity_ < bytes) {
+        buffer_.reset(new char[bytes]);
+        capacity_ = bytes;
+    }
+}
+
+void TsvWriter::header() {
+    reserve(TSV_HEADER.size());
+    memcpy(buffer_.get() + used_, TSV_HEADER.data(), TSV_HEADER.size());
+    used_ += TSV_HEADER.size();
+}
+
+void TsvWriter::row(const LogRecord& rec, std::string_view url) {
+    reserve(max_row_size(rec, url));
+    used_ = static_cast<size_t>(serialize_row(buffer_.get() + used_, rec, url, escaped_) -
+                                buffer_.get());
+}
+
+void TsvWriter::flush() {
+    sink_->write({buffer_.get(), used_});
+    used_ = 0;
+}
+
+GatherWriter::GatherWriter(OutputSink& sink)
+    : sink_ {&sink}, scratch_ {new char[SCRATCH_SIZE]} {
+    pieces_.reserve(IOV_MAX);
+}
+
+void GatherWriter::add_piece(const char* data, size_t size) {
+    if (size == 0)
+        return;
+    // pieces that follow each other in the scratch buffer are one piece
+    if (!pieces_.empty()) {
+        auto& last { pieces_.back() };
+        if (static_cast<const char*>(last.iov_base) + last.iov_len == data) {
+            last.iov_len += size;
+            return;
+        }
+    }
+    pieces_.push_back({const_cast<char*>(data), size});
+}
+
+void GatherWriter::header() {
+    add_piece(TSV_HEADER.data(), TSV_HEADER.size());
+}
+
+void GatherWriter::row(const LogRecord& rec, std::string_view url) {
+    const bool dirty_url { find_unusual(rec.fullurl, 0, rec.fullurl_decoded) != rec.fullurl.size() };
+    const auto needed    { 1 + max_prefix_size(rec, url) +
+                           (dirty_url ? ESCAPE_GROWTH * rec.fullurl.size() : 0) };
+    if (pieces_.size() + 2 > IOV_MAX || SCRATCH_SIZE - used_ < needed)
+        flush();
+    if (SCRATCH_SIZE < needed) {
+        // too big to gather; write this one row on its own
+        std::unique_ptr<char[]> big {new char[needed + 1]};
+        char* out { big.get() };
+        if (pending_newline_)
+            *out++ = '\n';
+        out = put_row_prefix(out, rec, url, escaped_);
+        out = put_field(out, rec.fullurl, escaped_, rec.fullurl_decoded);
+        sink_->write({big.get(), static_cast<size_t>(out - big.get())});
+        pending_newline_ = true;
+        return;
+    }
+
+    char* start { scratch_.get() + used_ };
+    char* out   { start };
+    if (pending_newline_)
+        *out++ = '\n';
+    out = put_row_prefix(out, rec, url, escaped_);
+    if (dirty_url) {
+        out = put_field(out, rec.fullurl, escaped_, rec.fullurl_decoded);
+        add_piece(start, static_cast<size_t>(out - start));
+    } else {
+        add_piece(start, static_cast<size_t>(out - start));
+        add_piece(rec.fullurl.data(), rec.fullurl.size());
+    }
+    used_ = static_cast<size_t>(out - scratch_.get());
+    pending_newline_ = true;
+}
+
+void GatherWriter::flush() {
+    if (pending_newline_) {
+        static constexpr char NEWLINE {'\n'};
+        add_piece(&NEWLINE, 1);
+        pending_newline_ = false;
+    }
+    sink_->write_gather(pieces_);
+    pieces_.clear();
+    used_ = 0;
+}
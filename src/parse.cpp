@@ -0,0 +1,325 @@
+#include "parse.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "decompress.h"
+#include "url.h"
+
+Batch::Batch()                           = default;
+Batch::Batch(Batch&&) noexcept            = default;
+Batch& Batch::operator=(Batch&&) noexcept = default;
+Batch::~Batch()                           = default;
+
+namespace {
+
+int open_or_throw(const std::string& path) {
+    const auto fd { open(path.c_str(), O_RDONLY) };
+    if (fd == -1)
+        throw std::runtime_error {fmt::format("couldn't open {}", path)};
+    return fd;
+}
+
+size_t file_size(int fd, const std::string& path) {
+    struct stat st{};
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error {fmt::format("couldn't stat {}", path)};
+    }
+    return static_cast<size_t>(st.st_size);
+}
+
+// the offset just past the first newline at or after `from` (or `size`
+// if there isn't one), i.e. where the next whole line starts
+size_t next_line_start(int fd, size_t from, size_t size) {
+    char window[4096];
+    while (from < size) {
+        const auto nread { pread(fd, window, sizeof(window),
+                                 static_cast<off_t>(from)) };
+        if (nread <= 0)
+            break;
+        const auto* nl { static_cast<const char*>(
+                memchr(window, '\n', static_cast<size_t>(nread))) };
+        if (nl != nullptr)
+            return from + static_cast<size_t>(nl - window) + 1;
+        from += static_cast<size_t>(nread);
+    }
+    return size;
+}
+
+#ifndef MMAPINPUT
+// bytes [begin, end) of the file, pread(2) into one buffer
+std::unique_ptr<char[]> read_range(const std::string& path, size_t begin,
+                                   size_t end, size_t& size) {
+    const auto fd { open_or_throw(path) };
+    posix_fadvise(fd, static_cast<off_t>(begin),
+                  static_cast<off_t>(end - begin), POSIX_FADV_SEQUENTIAL);
+    std::unique_ptr<char[]> buffer {new char[end - begin]};
+    size_t got {0};
+    while (begin + got < end) {
+        const auto nread { pread(fd, buffer.get() + got, end - begin - got,
+                                 static_cast<off_t>(begin + got)) };
+        if (nread <= 0)
+            break;
+        got += static_cast<size_t>(nread);
+    }
+    close(fd);
+    size = got;
+    return buffer;
+}
+#endif
+
+// a guess at how many rows a chunk of log holds, so the row vector
+// (usually) only gets allocated once
+constexpr size_t MIN_BYTES_PER_ROW {64};
+
+void parse_text(std::string_view text, const LogFormat& format, const FilterRules& rules,
+                const ColumnRewrites& rewrites, Batch& batch) {
+    batch.rows.reserve(text.size() / MIN_BYTES_PER_ROW);
+    LineParser parser {format, rules, rewrites};
+    parser.parse(text, batch.rows);
+    batch.rejected = parser.rejected();
+    batch.decoded  = parser.take_decoded();
+    batch.tallied  = parser.take_tallied();
+}
+
+// some of our barcodes are logged with an (encoded) no-break space and
+// an "x" in front of them
+constexpr std::string_view BARCODE_JUNK {"%a0x"};
+
+std::string_view decode_barcode(DecodeArena& decoded, std::string_view barcode) {
+    if (barcode.size() > BARCODE_JUNK.size() && barcode.starts_with(BARCODE_JUNK))
+        barcode.remove_prefix(BARCODE_JUNK.size());
+    return decoded.decode(barcode);
+}
+
+// a FieldLayout known at compile time: the same fields, as constants
+template <FieldLayout L>
+struct FixedLayout {
+    static constexpr size_t host    {L.host};
+    static constexpr size_t user    {L.user};
+    static constexpr size_t session {L.session};
+    static constexpr size_t time    {L.time};
+    static constexpr size_t request {L.request};
+    static constexpr size_t status  {L.status};
+    static constexpr size_t bytes   {L.bytes};
+    static constexpr size_t fields  {L.fields};
+};
+
+// fills `rec` from `line`, whose fields are where `layout` (a
+// FieldLayout, or a FixedLayout) says, lexing it into at most `CAPACITY`
+// fields; returns the filter's verdict: DROP for lines we don't keep
+// (filtered out, or no barcode), and TALLY for the ones only the stats
+// want, which are only parsed as far as they need
+template <size_t CAPACITY, typename Layout>
+LineFilter::Verdict parse_line(const Layout& layout, LineParser::State& state,
+                               std::string_view line, LogRecord& rec) {
+    auto verdict { state.filter.check(line, state.rejected) };
+    if (verdict == LineFilter::Verdict::DROP)
+        return verdict;
+    std::string_view fields[CAPACITY] {};
+    lex_fields(line, fields, layout.fields);
+    if (verdict == LineFilter::Verdict::LEX) {
+        verdict = state.filter.check(fields, state.rejected);
+        if (verdict == LineFilter::Verdict::DROP)
+            return verdict;
+    }
+    const auto field = [&](size_t i) {
+        return i == NO_FIELD ? std::string_view{} : fields[i];
+    };
+
+    state.dates.convert(fields[layout.time], fields[layout.time + 1], rec.date, rec.epoch);
+    rec.fullurl = request_url(fields[layout.request]);
+    rec.url     = get_small_url(rec.fullurl);
+    const auto status { parse_decimal(line, field(layout.status)) };
+    rec.status  = static_cast<uint16_t>(status < 1000 ? status : 0);
+    rec.bytes   = parse_decimal(line, field(layout.bytes));
+    if (verdict == LineFilter::Verdict::TALLY)
+        return verdict;
+
+    rec.barcode = fields[layout.user];
+    rec.ip      = field(layout.host);
+    rec.session = field(layout.session);
+    // the url column is cut from the URL as logged: an encoded host
+    // isn't one we'd find in the vendor crosswalk anyway
+    if (state.rewrites.decode_barcode) {
+        rec.barcode = decode_barcode(state.decoded, rec.barcode);
+        rec.barcode_decoded = true;
+    }
+    if (state.rewrites.decode_fullurl) {
+        rec.fullurl = state.decoded.decode(rec.fullurl);
+        rec.fullurl_decoded = true;
+    }
+    if (state.rewrites.truncate_ips) {
+        rec.address = parse_ip(rec.ip);
+        truncate_ip(rec.address);
+        // the full address mustn't make it out some other way
+        rec.ip = {};
+    }
+    return LineFilter::Verdict::KEEP;
+}
+
+template <size_t CAPACITY, typename Layout>
+void parse_lines(const Layout& layout, LineParser::State& state,
+                 std::string_view text, std::vector<LogRecord>& rows) {
+    for_each_line(text, [&](std::string_view line) {
+        auto& rec { rows.emplace_back() };
+        const auto verdict { parse_line<CAPACITY>(layout, state, line, rec) };
+        if (verdict == LineFilter::Verdict::KEEP)
+            return;
+        if (verdict == LineFilter::Verdict::TALLY)
+            state.tallied.push_back(rec);
+        rows.pop_back();
+    });
+}
+
+template <FieldLayout L>
+void parse_known(LineParser::State& state, std::string_view text,
+                 std::vector<LogRecord>& rows) {
+    parse_lines<L.fields>(FixedLayout<L>{}, state, text, rows);
+}
+
+void parse_any(LineParser::State& state, std::string_view text,
+               std::vector<LogRecord>& rows) {
+    parse_lines<MAX_FIELDS>(state.layout, state, text, rows);
+}
+
+LineParser::text_parser pick_text_parser(const FieldLayout& layout) noexcept {
+    if (layout == EZPROXY_LAYOUT)
+        return parse_known<EZPROXY_LAYOUT>;
+    if (layout == COMMON_LAYOUT)
+        return parse_known<COMMON_LAYOUT>;
+    return parse_any;
+}
+
+} // namespace
+
+LineParser::LineParser(const LogFormat& format, const FilterRules& rules,
+                       const ColumnRewrites& rewrites)
+    : state_ {format.layout(), {format.layout(), rules}, {}, {}, rewrites, {}, {}},
+      parse_ {pick_text_parser(format.layout())} {
+}
+
+void LineParser::parse(std::string_view text, std::vector<LogRecord>& rows) {
+    parse_(state_, text, rows);
+}
+
+std::vector<Task> plan_tasks(const std::vector<std::string>& files,
+                             size_t chunk_bytes) {
+    std::vector<Task> tasks {};
+    tasks.reserve(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        // compressed logs can only be read from the start, so they're
+        // one task each
+        if (is_compressed(files[i])) {
+            tasks.push_back({i, 0, 0});
+            continue;
+        }
+        const auto fd   { open_or_throw(files[i]) };
+        const auto size { file_size(fd, files[i]) };
+        size_t begin    {0};
+        while (chunk_bytes != 0 && size - begin > chunk_bytes) {
+            // the line straddling the nominal cut goes to the first chunk
+            const auto end { next_line_start(fd, begin + chunk_bytes - 1, size) };
+            tasks.push_back({i, begin, end});
+            begin = end;
+        }
+        if (begin < size || begin == 0)
+            tasks.push_back({i, begin, size});
+        close(fd);
+    }
+    return tasks;
+}
+
+Batch parse_task(const std::string& path, const Task& task, const LogFormat& format,
+                 const FilterRules& rules, const ColumnRewrites& rewrites) {
+    Batch batch {};
+    size_t size {0};
+    std::string_view text {};
+    if (is_compressed(path)) {
+        // the whole log is decompressed before parsing starts; with
+        // several threads, that overlaps with other tasks' parsing
+        batch.buffer = read_decompressed(path, size);
+        text = {batch.buffer.get(), size};
+    } else {
+#ifdef MMAPINPUT
+        batch.mapping = std::make_shared<const MappedFile>(path, task.begin, task.end);
+        text = batch.mapping->view();
+#else
+        batch.buffer = read_range(path, task.begin, task.end, size);
+        text = {batch.buffer.get(), size};
+#endif
+    }
+    parse_text(text, format, rules, rewrites, batch);
+    return batch;
+}
+
+Batch parse_buffer(std::unique_ptr<char[]> buffer, size_t size, const LogFormat& format,
+                   const FilterRules& rules, const ColumnRewrites& rewrites) {
+    Batch batch {};
+    batch.buffer = std::move(buffer);
+    parse_text({batch.buffer.get(), size}, format, rules, rewrites, batch);
+    return batch;
+}
+
+FdSource::FdSource(int fd, std::string name)
+    : fd_ {fd}, name_ {std::move(name)} {
+}
+
+size_t FdSource::read(char* out, size_t size) {
+    for (;;) {
+        const auto nread { ::read(fd_, out, size) };
+        if (nread >= 0)
+            return static_cast<size_t>(nread);
+        if (errno != EINTR)
+            throw std::runtime_error {fmt::format("couldn't read {}: {}",
+                                                  name_, strerror(errno))};
+    }
+}
+
+LineChunker::LineChunker(ByteSource& source, size_t chunk_bytes)
+    : source_ {&source}, chunk_bytes_ {chunk_bytes} {
+}
+
+bool LineChunker::next(std::unique_ptr<char[]>& buffer, size_t& size) {
+    if (eof_ && carry_.empty())
+        return false;
+    size_t capacity { std::max(chunk_bytes_, 2 * carry_.size()) };
+    buffer.reset(new char[capacity]);
+    size = carry_.size();
+    memcpy(buffer.get(), carry_.data(), carry_.size());
+    carry_.clear();
+
+    size_t searched {0};
+    for (;;) {
+        while (!eof_ && size < capacity) {
+            const auto nread { source_->read(buffer.get() + size, capacity - size) };
+            if (nread == 0)
+                eof_ = true;
+            size += nread;
+        }
+        if (eof_)
+            return size > 0;
+        const auto* last { static_cast<const char*>(
+                memrchr(buffer.get() + searched, '\n', size - searched)) };
+        if (last != nullptr) {
+            // hold on to the partial line for next time
+            const auto keep { static_cast<size_t>(buffer.get() + size - last - 1) };
+            carry_.assign(last + 1, keep);
+            size -= keep;
+            return true;
+        }
+        // a line longer than the whole buffer
+        searched = size;
+        std::unique_ptr<char[]> bigger {new char[2 * capacity]};
+        memcpy(bigger.get(), buffer.get(), size);
+        buffer = std::move(bigger);
+        capacity *= 2;
+    }
+}
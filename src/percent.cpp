@@ -0,0 +1,116 @@
+#include "percent.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// room for a few thousand decoded URLs, so a batch needs few blocks
+constexpr size_t ARENA_BLOCK_SIZE {256 * 1024};
+
+// the value of a hex digit, or -1
+constexpr int hex_value(char c) noexcept {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+size_t find_percent(std::string_view text) noexcept {
+    size_t i {0};
+#if defined(__x86_64__)
+    const __m128i percent { _mm_set1_epi8('%') };
+    for (; i + 16 <= text.size(); i += 16) {
+        const __m128i chunk { _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(text.data() + i)) };
+        const auto mask { static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, percent))) };
+        if (mask != 0)
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+#endif
+    for (; i < text.size(); ++i)
+        if (text[i] == '%')
+            return i;
+    return text.size();
+}
+
+char* percent_decode(std::string_view text, size_t from, char* out) noexcept {
+    memcpy(out, text.data(), from);
+    out += from;
+    size_t i { from };
+    while (i < text.size()) {
+        if (text[i] != '%') {
+#if defined(__x86_64__)
+            // copy whole blocks up to the next '%'; decoding only ever
+            // shrinks the text, so a block stored at `out` always fits
+            const __m128i percent { _mm_set1_epi8('%') };
+            if (i + 16 <= text.size()) {
+                const __m128i chunk { _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(text.data() + i)) };
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chunk);
+                const auto mask { static_cast<unsigned>(
+                        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, percent))) };
+                const auto run { mask == 0 ? size_t{16}
+                                           : static_cast<size_t>(__builtin_ctz(mask)) };
+                i   += run;
+                out += run;
+                continue;
+            }
+#endif
+            *out++ = text[i++];
+            continue;
+        }
+        const auto high { i + 2 < text.size() ? hex_value(text[i + 1]) : -1 };
+        const auto low  { i + 2 < text.size() ? hex_value(text[i + 2]) : -1 };
+        if (high < 0 || low < 0) {
+            *out++ = text[i++];
+            continue;
+        }
+        *out++ = static_cast<char>(high << 4 | low);
+        i += 3;
+    }
+    return out;
+}
+
+DecodeArena::DecodeArena()  = default;
+DecodeArena::~DecodeArena() = default;
+
+// a moved-from arena starts over with a block of its own
+DecodeArena::DecodeArena(DecodeArena&& other) noexcept
+    : blocks_ {std::move(other.blocks_)},
+      next_ {std::exchange(other.next_, nullptr)},
+      end_ {std::exchange(other.end_, nullptr)} {
+}
+
+DecodeArena& DecodeArena::operator=(DecodeArena&& other) noexcept {
+    blocks_ = std::move(other.blocks_);
+    next_   = std::exchange(other.next_, nullptr);
+    end_    = std::exchange(other.end_, nullptr);
+    return *this;
+}
+
+std::string_view DecodeArena::decode(std::string_view text) {
+    const auto first { find_percent(text) };
+    if (first == text.size())
+        return text;
+    if (static_cast<size_t>(end_ - next_) < text.size()) {
+        const auto size { std::max(ARENA_BLOCK_SIZE, text.size()) };
+        blocks_.emplace_back(new char[size]);
+        next_ = blocks_.back().get();
+        end_  = next_ + size;
+    }
+    char* const start { next_ };
+    next_ = percent_decode(text, first, start);
+    return {start, static_cast<size_t>(next_ - start)};
+}
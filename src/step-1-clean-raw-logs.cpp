@@ -10,6 +10,15 @@ int get_current_year(void);
 const int CURRENT_YEAR {get_current_year()};
 
 const auto LOG_LOC {fmt::format("./logs/i.ezproxy.nypl.org.{}-*.log", CURRENT_YEAR)};
+// daily logs inside an --archive, which can be of any year
+constexpr char ARCHIVED_LOG[] {"i.ezproxy.nypl.org.[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9].log"};
+
+// rows are serialized into a buffer this big before each write(2)
+constexpr size_t OUTPUT_BUFFER_SIZE {8 << 20};
+// with --pipe, what we ask the kernel to grow stdin and stdout pipes to
+constexpr int PIPE_BUFFER_SIZE {1 << 20};
+// with --follow, how often we look for SIGINT while the log is quiet
+constexpr int FOLLOW_TIMEOUT_MS {1000};
 
 static ProgressBar bar{
         option::BarWidth{70},
@@ -49,10 +58,25 @@ void handle_sigint(const int signum) {
     exit(1);
 }
 
-const vector<string> get_files() noexcept {
+// the log without any compression suffix: "...2026-03-05.log"
+string_view log_name(string_view path) noexcept {
+    return path.substr(0, path.rfind(".log") + 4);
+}
+
+// "2026-03-05", from any daily log's path
+string log_date(const string& path) {
+    return path.substr(path.rfind('/') + 1 + 19, 10);
+}
+
+// every complete day's logs, in date order: one per EZproxy node, where
+// the first node's are in logs/ and any others' in logs/NODE/; the logs
+// still being written go in `live`
+const vector<vector<string>> get_days(vector<string>& live) noexcept {
     vector<string> input_files;
     input_files.reserve(366);
-    for (const auto& p : glob::glob(LOG_LOC)) {
+    const auto node_logs { fmt::format("./logs/*/i.ezproxy.nypl.org.{}-*.log", CURRENT_YEAR) };
+    for (const auto& p : glob::glob({LOG_LOC, LOG_LOC + ".gz", LOG_LOC + ".zst",
+                                     node_logs, node_logs + ".gz", node_logs + ".zst"})) {
         input_files.push_back(p);
         #ifdef SAMPLE
         // if (input_files.size() > 2) break;
@@ -60,117 +84,527 @@ const vector<string> get_files() noexcept {
         #endif
     }
     sort(input_files.begin(), input_files.end());
+    // a day that's there both compressed and not (say, while it's being
+    // compressed) is read once, from the plain log, which sorts first
+    input_files.erase(unique(input_files.begin(), input_files.end(),
+                             [](const string& a, const string& b) {
+                                 return log_name(a) == log_name(b);
+                             }),
+                      input_files.end());
+    // by day, then node
+    stable_sort(input_files.begin(), input_files.end(),
+                [](const string& a, const string& b) {
+                    return log_date(a) < log_date(b);
+                });
+    vector<vector<string>> days {};
+    for (auto& file : input_files) {
+        if (days.empty() || log_date(days.back().front()) != log_date(file))
+            days.emplace_back();
+        days.back().push_back(std::move(file));
+    }
     // remove last (incomplete log)
-    if (input_files.size() < num_days_in_year(CURRENT_YEAR))
-        input_files.pop_back();
-    return input_files;
+    if (days.size() < num_days_in_year(CURRENT_YEAR)) {
+        live = std::move(days.back());
+        days.pop_back();
+    }
+    return days;
 }
 
-void process_line(string* all_fields, const string& line) noexcept {
-    uint8_t counter {0};
-    string item {};
-    stringstream ss {line};
+// the output file's name, given its name uncompressed
+string output_name(const Options& opts, const string& base) {
+    if (opts.zstd_level > 0)
+        return base + ".zst";
+    if (opts.bgzf_level > 0)
+        return base + ".gz";
+    return base;
+}
 
-    while (std::getline(ss, item, ' ')) {
-        all_fields[counter] = move(item);
-        ++counter;
-        if (counter > 6)
-            return;
+unique_ptr<OutputSink> open_output(const Options& opts, const string& base) {
+    if (opts.zstd_level > 0)
+        return make_zstd_sink(output_name(opts, base), opts.zstd_level);
+    return make_unique<FdSink>(output_name(opts, base));
+}
+
+// the writer for whichever output format `opts` asks for
+unique_ptr<RowWriter> make_writer(const Options& opts, OutputSink& sink,
+                                  const string& index_path) {
+    if (opts.bgzf_level > 0)
+        return make_unique<BgzfWriter>(sink, index_path, opts.bgzf_level,
+                                       opts.threads);
+    if (opts.gather)
+        return make_unique<GatherWriter>(sink);
+    return make_unique<TsvWriter>(sink, OUTPUT_BUFFER_SIZE);
+}
+
+// writes `rec`, with its interned host id in the url column if there's
+// a `hosts` table, and counts it if there are `stats`
+void write_row(const LogRecord& rec, RowWriter& out, HostTable* hosts,
+               TrafficStats* stats) {
+    if (stats != nullptr)
+        stats->add(rec);
+    if (hosts == nullptr) {
+        out.row(rec, rec.url);
+        return;
     }
+    char host_id[16] {};
+    const auto id  { hosts->intern(rec.url) };
+    const auto len { to_chars(begin(host_id), end(host_id), id).ptr - host_id };
+    out.row(rec, {host_id, static_cast<size_t>(len)});
 }
 
-const string fix_whole_date(const string& adate) noexcept {
-    struct tm tm{};
-    strptime(adate.c_str(), "[%d/%b/%Y:%T", &tm);
-    char datestring[20] {0};
-    strftime(datestring, 20, "%F %T", &tm);
-    string ret {datestring};
-    return ret;
+// counts the lines that were dropped, but not from the stats, if there
+// are `stats`
+void tally(const vector<LogRecord>& tallied, TrafficStats* stats) {
+    if (stats == nullptr)
+        return;
+    for (const auto& rec : tallied)
+        stats->add(rec);
+}
+
+void write_batch(const Batch& batch, RowWriter& out, HostTable* hosts,
+                 TrafficStats* stats) {
+    for (const auto& rec : batch.rows)
+        write_row(rec, out, hosts, stats);
+    tally(batch.tallied, stats);
+    // the batch (and the input its rows point into) goes away once the
+    // caller is done with it
+    out.release_input();
+}
+
+// the files written next to the output, named after its last day
+string hosts_name(const string& date) {
+    return fmt::format("intermediate/cleaned-hosts-{}.dat", date);
 }
 
-const char* get_small_url(string fullurl) {
-    const auto urlsize   { fullurl.size() };
-    char* cfullurl       { const_cast<char*>(fullurl.c_str()) };
-    char* starting_point { static_cast<char*>(memrchr(cfullurl, '/', 10)) };
-    if (starting_point==nullptr)
-        throw std::runtime_error {fmt::format("URL string ({}) malformed", fullurl)};
-    starting_point++;
-    char* ending_point { static_cast<char*>(memchr(starting_point, ':', urlsize-10)) };
-    if (ending_point==nullptr)
-        throw std::runtime_error {fmt::format("URL string ({}) malformed", fullurl)};
-    *ending_point = '\0';
-    // special case for "58122.on.worldcat.org" (and possibly more)
-    if (isdigit(starting_point[0])) {
-        char* new_starting_p { static_cast<char*>(memchr(starting_point, '.', urlsize-10)) };
-        if (isdigit(*(new_starting_p-1)))
-            starting_point = new_starting_p+1;
+string stats_name(const string& date) {
+    return fmt::format("intermediate/cleaned-stats-{}.dat", date);
+}
+
+// a file written next to the output (the host dictionary, or the
+// stats), created up front along with it, so a path we can't write to
+// stops the run before it parses anything
+class SideFile final {
+  public:
+    explicit SideFile(string path);
+
+    // replaces the file's contents with what `table.write(FILE*)` writes
+    template <typename Table>
+    void write(const Table& table);
+
+    // gives the file its final name
+    void rename(const string& path);
+
+  private:
+    [[noreturn]] void fail(const char* what) const;
+
+    string path_                     {};
+    unique_ptr<FILE, int (*)(FILE*)> file_;
+};
+
+SideFile::SideFile(string path)
+    : path_ {std::move(path)}, file_ {fopen(path_.c_str(), "w"), &fclose} {
+    if (!file_)
+        fail("couldn't create");
+}
+
+void SideFile::fail(const char* what) const {
+    throw runtime_error {fmt::format("{} {}: {}", what, path_, strerror(errno))};
+}
+
+template <typename Table>
+void SideFile::write(const Table& table) {
+    // --follow writes the host dictionary again as new hosts turn up
+    rewind(file_.get());
+    if (ftruncate(fileno(file_.get()), 0) == -1)
+        fail("couldn't truncate");
+    table.write(file_.get());
+    if (fflush(file_.get()) != 0)
+        fail("couldn't write to");
+}
+
+void SideFile::rename(const string& path) {
+    if (::rename(path_.c_str(), path.c_str()) == -1)
+        throw runtime_error {fmt::format("couldn't rename {} to {}: {}",
+                                         path_, path, strerror(errno))};
+    path_ = path;
+}
+
+// how many lines were thrown out, and why
+string dropped(const FilterCounts& rejected) {
+    return fmt::format("{} lines dropped ({} without a barcode, {} from "
+                       "excluded hosts, {} outside the dates)",
+                       rejected.total(), rejected.no_barcode,
+                       rejected.excluded_host, rejected.outside_dates);
+}
+
+// the input files whose rows had fields escaped on the way out, and how
+// many, so a bad day's log can be looked into
+struct EscapeLog {
+    // what the writer had escaped when the last file was noted
+    EscapeCounts seen {};
+    vector<pair<string, EscapeCounts>> files {};
+
+    // puts the fields `out` escaped since the last call down to `file`
+    void note(const RowWriter& out, const string& file) {
+        const auto since { out.escaped() - seen };
+        seen = out.escaped();
+        if (since.any())
+            files.emplace_back(file, since);
+    }
+
+    // one line per file
+    vector<string> lines() const {
+        vector<string> result {};
+        for (const auto& [file, counts] : files)
+            result.push_back(fmt::format("{}: escaped {} fields with tabs, line "
+                                         "breaks or other control characters, {} "
+                                         "that weren't UTF-8", file,
+                                         counts.control, counts.invalid_utf8));
+        return result;
+    }
+};
+
+// parses everything in `source`: `opts.threads` chunks are read, then
+// parsed in parallel and handed to `consume` in order, then the next
+// ones are read
+void parse_stream(ByteSource& source, const Options& opts,
+                  const function<void(Batch&&)>& consume) {
+    LineChunker input {source, opts.chunk_size};
+    vector<pair<unique_ptr<char[]>, size_t>> chunks {};
+    for (bool more {true}; more;) {
+        chunks.clear();
+        while (chunks.size() < max<size_t>(opts.threads, 1)) {
+            auto& [buffer, size] { chunks.emplace_back() };
+            if (!input.next(buffer, size)) {
+                chunks.pop_back();
+                more = false;
+                break;
+            }
+        }
+        ordered_parallel_for<Batch>(chunks.size(), opts.threads,
+            [&](size_t i) {
+                return parse_buffer(std::move(chunks[i].first), chunks[i].second,
+                                    opts.log_format, opts.filter, opts.rewrites);
+            },
+            consume);
     }
-    return starting_point;
 }
 
-int main() {
+// --pipe: log text from stdin, cleaned rows to stdout, nothing on disk
+int run_pipe(const Options& opts) {
+    // not every stdin/stdout is a pipe, so these are allowed to fail
+    fcntl(STDIN_FILENO, F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+    fcntl(STDOUT_FILENO, F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+
+    unique_ptr<OutputSink> outfile {};
+    if (opts.zstd_level > 0)
+        outfile = make_zstd_sink("", opts.zstd_level);
+    else
+        outfile = make_unique<FdSink>(STDOUT_FILENO, "standard output");
+    // the BGZF index needs a file to go in, so there isn't one here
+    const auto out { make_writer(opts, *outfile, "") };
+    out->header();
+
+    FdSource stdin_source {STDIN_FILENO, "standard input"};
+    size_t rows {0};
+    FilterCounts rejected {};
+    parse_stream(stdin_source, opts, [&](Batch&& batch) {
+        write_batch(batch, *out, nullptr, nullptr);
+        rows += batch.rows.size();
+        rejected += batch.rejected;
+    });
+    out->finish();
+    outfile->finish();
+
+    EscapeLog escapes {};
+    escapes.note(*out, "standard input");
+    cerr << fmt::format("{} rows written, {}\n", rows, dropped(rejected));
+    for (const auto& line : escapes.lines())
+        cerr << line << "\n";
+    return 0;
+}
+
+// the first node's live log: the one in `live` that's in logs/ itself,
+// or (if none of them is) the log for the day after `last_date`, which
+// hasn't been started yet
+string live_log(const vector<string>& live, const string& last_date) {
+    for (const auto& path : live)
+        if (count(path.begin(), path.end(), '/') == 1)
+            return path;
+    using namespace std::chrono;
+    const year_month_day next { sys_days{year_month_day{
+        year{stoi(last_date.substr(0, 4))},
+        month{static_cast<unsigned>(stoi(last_date.substr(5, 2)))},
+        day{static_cast<unsigned>(stoi(last_date.substr(8, 2)))}}} + days{1} };
+    return fmt::format("logs/i.ezproxy.nypl.org.{:04}-{:02}-{:02}.log",
+                       static_cast<int>(next.year()),
+                       static_cast<unsigned>(next.month()),
+                       static_cast<unsigned>(next.day()));
+}
+
+// set by SIGINT while following, so the output still gets finished
+volatile sig_atomic_t stop_following {0};
+
+void handle_sigint_following(const int) {
+    stop_following = 1;
+}
+
+// --follow: writes the live log's rows as they're logged (and then the
+// next day's, and so on) until SIGINT; returns how many, adds the lines
+// it threw out to `rejected`, notes each log's escapes in `escapes`, and
+// rewrites `hosts_file` whenever there are new `hosts`
+size_t follow_live(const string& path, const Options& opts, RowWriter& out,
+                   HostTable* hosts, TrafficStats* stats, SideFile* hosts_file,
+                   FilterCounts& rejected, EscapeLog& escapes) {
+    signal(SIGINT, handle_sigint_following);
+    LogTail tail {path, opts.chunk_size};
+    string following {};
+    size_t rows        {0};
+    size_t known_hosts { hosts == nullptr ? 0 : hosts->size() };
+    unique_ptr<char[]> buffer {};
+    size_t size {0};
+    while (!stop_following) {
+        if (tail.path() != following) {
+            if (!following.empty())
+                escapes.note(out, following);
+            following = tail.path();
+            cout << "\n" << fg::gray << style::dim << display_time()
+                 << "following " << following << style::reset << endl;
+        }
+        if (!tail.next(buffer, size, FOLLOW_TIMEOUT_MS))
+            continue;
+        const auto batch { parse_buffer(std::move(buffer), size, opts.log_format,
+                                        opts.filter, opts.rewrites) };
+        write_batch(batch, out, hosts, stats);
+        rows += batch.rows.size();
+        rejected += batch.rejected;
+        // small batches: whatever was just logged goes out now
+        out.flush();
+        if (hosts != nullptr && hosts->size() != known_hosts) {
+            hosts_file->write(*hosts);
+            known_hosts = hosts->size();
+        }
+    }
+    escapes.note(out, following);
+    return rows;
+}
+
+// how far through its year "YYYY-MM-DD" is, in percent
+size_t year_progress(const string& date) {
+    using namespace std::chrono;
+    const auto y { stoi(date.substr(0, 4)) };
+    const year_month_day ymd { year{y},
+                               month{static_cast<unsigned>(stoi(date.substr(5, 2)))},
+                               day{static_cast<unsigned>(stoi(date.substr(8, 2)))} };
+    const auto day_of_year { (sys_days{ymd} - sys_days{year{y}/January/1}).count() + 1 };
+    return static_cast<size_t>(day_of_year) * 100 / num_days_in_year(y);
+}
+
+// --archive: every daily log in a tar file, in the order they're stored
+int run_archive(const Options& opts) {
+    // the output is named after the last day in the archive, which we
+    // only know at the end, so it's written under this name until then
+    const string partial { "intermediate/cleaned-logs-partial.dat" };
+    const auto outfile   { open_output(opts, partial) };
+    const auto out       { make_writer(opts, *outfile, output_name(opts, partial) + ".idx") };
+    const auto hosts_file { opts.host_ids ? make_unique<SideFile>(hosts_name("partial")) : nullptr };
+    const auto stats_file { opts.stats ? make_unique<SideFile>(stats_name("partial")) : nullptr };
+    out->header();
+
+    size_t rows  {0};
+    size_t files {0};
+    FilterCounts rejected {};
+    EscapeLog escapes {};
+    string last_date {};
+    HostTable hosts {};
+    // the stats' own, so hosts only seen on dropped lines don't take up ids
+    HostTable stats_hosts {};
+    TrafficStats stats {stats_hosts};
+    TrafficStats* const traffic { opts.stats ? &stats : nullptr };
+
+    show_console_cursor(false);
+
+    TarReader tar {opts.archive};
+    string name {};
+    const auto allocs_before { heap_allocations() };
+    while (tar.next_member(name)) {
+        const auto base { name.substr(name.rfind('/') + 1) };
+        if (fnmatch(ARCHIVED_LOG, base.c_str(), 0) != 0)
+            continue;
+        parse_stream(tar, opts, [&](Batch&& batch) {
+            write_batch(batch, *out, opts.host_ids ? &hosts : nullptr, traffic);
+            rows += batch.rows.size();
+            rejected += batch.rejected;
+        });
+        escapes.note(*out, name);
+        const auto date { base.substr(19, 10) };
+        last_date = max(last_date, date);
+        ++files;
+        bar.set_option(option::PostfixText{ fmt::format("  {} logs  {}", files, date) });
+        bar.set_progress(year_progress(date));
+    }
+    const auto allocs { heap_allocations() - allocs_before };
+    tar.finish();
+    out->finish();
+    outfile->finish();
+    show_console_cursor(true);
+
+    if (files == 0) {
+        remove(output_name(opts, partial).c_str());
+        remove((output_name(opts, partial) + ".idx").c_str());
+        remove(hosts_name("partial").c_str());
+        remove(stats_name("partial").c_str());
+        throw runtime_error {fmt::format("no daily logs in {}", opts.archive)};
+    }
+    const string output_file {fmt::format("intermediate/cleaned-logs-{}.dat", last_date)};
+    rename(output_name(opts, partial).c_str(), output_name(opts, output_file).c_str());
+    if (opts.bgzf_level > 0)
+        rename((output_name(opts, partial) + ".idx").c_str(),
+               (output_name(opts, output_file) + ".idx").c_str());
+    if (hosts_file) {
+        hosts_file->write(hosts);
+        hosts_file->rename(hosts_name(last_date));
+    }
+    if (stats_file) {
+        stats_file->write(stats);
+        stats_file->rename(stats_name(last_date));
+    }
+
+    cout << "\n" << fg::gray << style::dim << display_time()
+         << fmt::format("{} rows written, {}, {} heap allocations while "
+                        "parsing {} files from {}", rows, dropped(rejected),
+                        allocs, files, opts.archive)
+         << style::reset << endl;
+    for (const auto& line : escapes.lines())
+        cout << fg::gray << style::dim << display_time() << line << style::reset << endl;
+    cout << style::bold << fg::green << display_time() << "Done!"
+         << style::reset << fg::reset << endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+
+    const Options opts { parse_args(argc, argv) };
 
     signal(SIGINT, handle_sigint);
 
+    if (opts.pipe)
+        return run_pipe(opts);
+
     cout << "\n\n" << fg::gray << style::dim
          << display_time() << "::alice glass:: HI!\n" << style::reset
          << style::bold << fg::cyan << display_time()
          << "Processing raw logs\n" << style::reset << endl;
 
-    const vector<string> input_files { get_files() };
-    const auto count                 { input_files.size() };
-    const string last_date           { input_files[count-1].substr(24, 10) };
-    uint32_t counter                 { 0 };
+    if (!opts.archive.empty())
+        return run_archive(opts);
+
+    vector<string> live {};
+    const vector<vector<string>> days { get_days(live) };
+    const auto count                  { days.size() };
+    const string last_date            { log_date(days[count-1].front()) };
+    uint32_t counter                  { 0 };
     const string output_file {fmt::format("intermediate/cleaned-logs-{}.dat", last_date)};
 
-    FILE* outfile { fopen(output_file.c_str(), "w") };
-    fmt::print(outfile, "{}\t{}\t{}\t{}\t{}\t{}\n",
-               "ip", "barcode", "session", "date_and_time", "url", "fullurl");
+    const auto outfile { open_output(opts, output_file) };
+    const auto out     { make_writer(opts, *outfile, output_name(opts, output_file) + ".idx") };
+    const auto hosts_file { opts.host_ids ? make_unique<SideFile>(hosts_name(last_date)) : nullptr };
+    const auto stats_file { opts.stats ? make_unique<SideFile>(stats_name(last_date)) : nullptr };
+    out->header();
 
-    // reusing this to store the necessary fields
-    string tmp[7] {};
+    size_t rows   {0};
+    FilterCounts rejected {};
+    EscapeLog escapes {};
+    HostTable hosts {};
+    HostTable* const host_table { opts.host_ids ? &hosts : nullptr };
+    HostTable stats_hosts {};
+    TrafficStats stats {stats_hosts};
+    TrafficStats* const traffic { opts.stats ? &stats : nullptr };
 
     show_console_cursor(false);
 
-    for (const auto& item : input_files) {
+    const auto day_done = [&] {
         ++counter;
         const auto perc { static_cast<size_t>(std::round(counter*100/count)) };
         bar.set_option(option::PostfixText{
                 fmt::format("  {}/{}  {}%", counter, count, perc) });
         bar.set_progress(perc);
+    };
 
-    #ifndef IOSTREAMINPUT
-        char* line    {nullptr};
-        size_t size   {0};
-        ssize_t read  {0};
-        FILE* infile  { fopen(item.c_str(), "r") };
-        const auto fd { fileno(infile) };
-        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
-        while ((read = getline(&line, &size, infile)) != -1) {
-    #else
-        ifstream infile {item};
-        string line {};
-        while (std::getline(infile, line)) {
-    #endif
-            process_line(tmp, line);
-
-            string barcode  { move(tmp[1]) }; if (barcode == "-") continue;
-            string ip       { move(tmp[0]) };
-            string sessionp { move(tmp[2]) };
-            string date     { fix_whole_date(move(tmp[3])) };
-            string fullurl  { move(tmp[6]) };
-            string url      { get_small_url(fullurl) };
-
-            fmt::print(outfile, "{}\t{}\t{}\t{}\t{}\t{}\n",
-                       ip, barcode, sessionp, date, url, fullurl);
+    const auto allocs_before { heap_allocations() };
+    for (size_t d = 0; d < count;) {
+        if (days[d].size() > 1) {
+            // several nodes logged this day: their rows are merged into
+            // time order as they're parsed
+            const auto& day { days[d++] };
+            LogMerger merger {day, opts.chunk_size, opts.log_format,
+                              opts.filter, opts.rewrites};
+            while (const auto* rec { merger.next() }) {
+                write_row(*rec, *out, host_table, traffic);
+                ++rows;
+                if (merger.retiring()) {
+                    out->release_input();
+                    tally(merger.tallied(), traffic);
+                    merger.release();
+                }
+            }
+            out->release_input();
+            tally(merger.tallied(), traffic);
+            rejected += merger.rejected();
+            escapes.note(*out, fmt::format("the {} logs of {}", day.size(),
+                                           log_date(day.front())));
+            day_done();
+            continue;
         }
-    #ifndef IOSTREAMINPUT
-        fclose(infile);
-    #endif
+
+        // a run of days from just the one node: rows are parsed into
+        // batches (one per file, or per chunk of a big file, on
+        // `opts.threads` threads) and written here in file order, so
+        // the output doesn't depend on how many threads there were
+        vector<string> input_files {};
+        for (; d < count && days[d].size() == 1; ++d)
+            input_files.push_back(days[d].front());
+        const vector<Task> tasks { plan_tasks(input_files,
+                                              opts.threads > 1 ? opts.chunk_size : 0) };
+        size_t done {0};
+        ordered_parallel_for<Batch>(tasks.size(), opts.threads,
+            [&](size_t i) {
+                return parse_task(input_files[tasks[i].file], tasks[i],
+                                  opts.log_format, opts.filter, opts.rewrites);
+            },
+            [&](Batch&& batch) {
+                write_batch(batch, *out, host_table, traffic);
+                rows += batch.rows.size();
+                rejected += batch.rejected;
+
+                const auto file { tasks[done++].file };
+                if (done < tasks.size() && tasks[done].file == file)
+                    return;
+                escapes.note(*out, input_files[file]);
+                day_done();
+            });
     }
+    const auto allocs { heap_allocations() - allocs_before };
+
+    if (opts.follow)
+        rows += follow_live(live_log(live, last_date), opts, *out, host_table,
+                            traffic, hosts_file.get(), rejected, escapes);
+
+    out->finish();
+    outfile->finish();
+
+    if (hosts_file)
+        hosts_file->write(hosts);
+    if (stats_file)
+        stats_file->write(stats);
 
     show_console_cursor(true);
+    cout << "\n" << fg::gray << style::dim << display_time()
+         << fmt::format("{} rows written, {}, {} heap allocations while "
+                        "parsing {} days", rows, dropped(rejected), allocs, count)
+         << style::reset << endl;
+    for (const auto& line : escapes.lines())
+        cout << fg::gray << style::dim << display_time() << line << style::reset << endl;
     cout << style::bold << fg::green << display_time() << "Done!"
          << style::reset << fg::reset << endl;
 }
-
@@ -0,0 +1,254 @@
+#include "tar_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "decompress.h"
+
+namespace {
+
+constexpr size_t RECORD_SIZE {512};
+// reads from the archive (or the decompressor's pipe) are this big
+constexpr size_t READ_SIZE   {1 << 20};
+// the most a GNU long name or pax header can hold: real ones are a few
+// hundred bytes, and the size comes from the archive, so a corrupt one
+// mustn't get to allocate whatever it says
+constexpr uint64_t MAX_HEADER_DATA {64 * 1024};
+
+// where the ustar header fields are
+constexpr size_t NAME_OFFSET     {0};
+constexpr size_t NAME_SIZE       {100};
+constexpr size_t SIZE_OFFSET     {124};
+constexpr size_t SIZE_SIZE       {12};
+constexpr size_t CHKSUM_OFFSET   {148};
+constexpr size_t CHKSUM_SIZE     {8};
+constexpr size_t TYPEFLAG_OFFSET {156};
+constexpr size_t MAGIC_OFFSET    {257};
+constexpr size_t PREFIX_OFFSET   {345};
+constexpr size_t PREFIX_SIZE     {155};
+
+bool ends_with(std::string_view path, std::string_view suffix) noexcept {
+    return path.size() >= suffix.size() &&
+           path.substr(path.size() - suffix.size()) == suffix;
+}
+
+// a NUL-terminated (unless it fills the field) header string
+std::string_view field(const char* header, size_t offset, size_t size) noexcept {
+    const std::string_view raw {header + offset, size};
+    return raw.substr(0, raw.find('\0'));
+}
+
+// sizes are octal, or big-endian base 256 when the top bit is set (GNU,
+// for members of 8 GiB and up)
+uint64_t parse_number(const char* header, size_t offset, size_t size) {
+    const auto* bytes { reinterpret_cast<const unsigned char*>(header + offset) };
+    uint64_t value {0};
+    if (bytes[0] & 0x80) {
+        value = bytes[0] & 0x7f;
+        for (size_t i = 1; i < size; ++i)
+            value = (value << 8) | bytes[i];
+        return value;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (bytes[i] == ' ' && value == 0)
+            continue;
+        if (bytes[i] < '0' || bytes[i] > '7')
+            break;
+        value = value * 8 + (bytes[i] - '0');
+    }
+    return value;
+}
+
+bool checksum_ok(const char* header) {
+    const auto* bytes { reinterpret_cast<const unsigned char*>(header) };
+    uint64_t sum {0};
+    for (size_t i = 0; i < RECORD_SIZE; ++i) {
+        const bool in_chksum { i >= CHKSUM_OFFSET && i < CHKSUM_OFFSET + CHKSUM_SIZE };
+        // the checksum is computed with its own field as spaces
+        sum += in_chksum ? static_cast<unsigned char>(' ') : bytes[i];
+    }
+    return sum == parse_number(header, CHKSUM_OFFSET, CHKSUM_SIZE);
+}
+
+// the "path" record of a pax extended header, if it has one; records
+// are "LENGTH KEY=VALUE\n"
+std::string pax_path(std::string_view records) {
+    std::string path {};
+    while (!records.empty()) {
+        const auto space { records.find(' ') };
+        if (space == std::string_view::npos)
+            break;
+        size_t length {0};
+        for (const char c : records.substr(0, space))
+            length = length * 10 + static_cast<size_t>(c - '0');
+        if (length <= space || length > records.size())
+            break;
+        auto record { records.substr(space + 1, length - space - 2) };
+        if (record.starts_with("path="))
+            path = record.substr(5);
+        records.remove_prefix(length);
+    }
+    return path;
+}
+
+// the archive itself, or the pipe from a child decompressing it
+int open_archive(const std::string& path, pid_t& pid) {
+    if (!ends_with(path, ".tar"))
+        return open_decompressor(path, pid);
+    const auto fd { open(path.c_str(), O_RDONLY) };
+    if (fd == -1)
+        throw std::runtime_error {fmt::format("couldn't open {}", path)};
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return fd;
+}
+
+uint64_t padding_for(uint64_t size) noexcept {
+    return (RECORD_SIZE - size % RECORD_SIZE) % RECORD_SIZE;
+}
+
+} // namespace
+
+TarReader::TarReader(const std::string& path)
+    : path_ {path}, fd_ {open_archive(path, pid_)}, source_ {fd_, path},
+      buffer_ {new char[READ_SIZE]} {
+}
+
+TarReader::~TarReader() {
+    if (fd_ != -1)
+        close(fd_);
+    // a decompressor we stopped reading from dies of SIGPIPE
+    if (pid_ != -1)
+        waitpid(pid_, nullptr, 0);
+}
+
+size_t TarReader::raw_read(char* out, size_t size) {
+    if (pos_ == end_) {
+        // big reads skip the buffer
+        if (size >= READ_SIZE)
+            return source_.read(out, size);
+        pos_ = 0;
+        end_ = source_.read(buffer_.get(), READ_SIZE);
+        if (end_ == 0)
+            return 0;
+    }
+    const auto take { std::min(size, end_ - pos_) };
+    memcpy(out, buffer_.get() + pos_, take);
+    pos_ += take;
+    return take;
+}
+
+void TarReader::read_exact(char* out, size_t size) {
+    while (size > 0) {
+        const auto got { raw_read(out, size) };
+        if (got == 0)
+            throw std::runtime_error {fmt::format("{} is truncated", path_)};
+        out  += got;
+        size -= got;
+    }
+}
+
+void TarReader::skip(uint64_t size) {
+    char discard[RECORD_SIZE * 8];
+    while (size > 0) {
+        const auto chunk { static_cast<size_t>(std::min<uint64_t>(size, sizeof(discard))) };
+        read_exact(discard, chunk);
+        size -= chunk;
+    }
+}
+
+std::string TarReader::read_string(uint64_t size, std::string_view what) {
+    if (size > MAX_HEADER_DATA)
+        throw std::runtime_error {fmt::format("{} has a {} of {} bytes (more than {}); "
+                                              "is it corrupt?", path_, what, size,
+                                              MAX_HEADER_DATA)};
+    std::string value (static_cast<size_t>(size), '\0');
+    read_exact(value.data(), value.size());
+    skip(padding_for(size));
+    return value;
+}
+
+bool TarReader::next_member(std::string& name) {
+    skip(remaining_ + padding_);
+    remaining_ = padding_ = 0;
+
+    // set by GNU long name or pax headers for the member after them
+    std::string long_name {};
+    char header[RECORD_SIZE];
+    for (;;) {
+        if (raw_read(header, 1) == 0)
+            return false;
+        read_exact(header + 1, RECORD_SIZE - 1);
+        // the archive ends with (at least) one record of zeros
+        if (std::all_of(std::begin(header), std::end(header),
+                        [](char c) { return c == '\0'; }))
+            return false;
+        if (!checksum_ok(header))
+            throw std::runtime_error {fmt::format("{} isn't a tar file (or is "
+                                                  "corrupt)", path_)};
+
+        const auto size { parse_number(header, SIZE_OFFSET, SIZE_SIZE) };
+        const char type { header[TYPEFLAG_OFFSET] };
+        if (type == 'L') {
+            long_name = read_string(size, "long name");
+            long_name = long_name.substr(0, long_name.find('\0'));
+            continue;
+        }
+        if (type == 'x') {
+            const auto path { pax_path(read_string(size, "pax header")) };
+            if (!path.empty())
+                long_name = path;
+            continue;
+        }
+        if (type != '0' && type != '\0' && type != '7') {
+            // directories, links, global pax headers...
+            skip(size + padding_for(size));
+            long_name.clear();
+            continue;
+        }
+
+        if (!long_name.empty()) {
+            name = long_name;
+        } else {
+            name = field(header, NAME_OFFSET, NAME_SIZE);
+            const auto prefix { field(header, PREFIX_OFFSET, PREFIX_SIZE) };
+            if (field(header, MAGIC_OFFSET, 5) == "ustar" && !prefix.empty())
+                name = fmt::format("{}/{}", prefix, name);
+        }
+        remaining_ = size;
+        padding_   = padding_for(size);
+        return true;
+    }
+}
+
+size_t TarReader::read(char* out, size_t size) {
+    const auto want { static_cast<size_t>(std::min<uint64_t>(size, remaining_)) };
+    if (want == 0)
+        return 0;
+    const auto got { raw_read(out, want) };
+    if (got == 0)
+        throw std::runtime_error {fmt::format("{} is truncated", path_)};
+    remaining_ -= got;
+    return got;
+}
+
+void TarReader::finish() {
+    // the rest is the zero records at the end; read them anyway, or the
+    // decompressor would be killed writing them
+    pos_ = end_;
+    while (source_.read(buffer_.get(), READ_SIZE) > 0) {}
+    close(fd_);
+    fd_ = -1;
+    if (pid_ == -1)
+        return;
+    const auto pid { pid_ };
+    pid_ = -1;
+    wait_decompressor(pid, path_);
+}
@@ -0,0 +1,167 @@
+#include "timestamp.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+constexpr std::array<std::string_view, 12> MONTH_NAMES {{
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+}};
+
+// offsets of the digits in "[dd/Mon/yyyy:hh:mm:ss"
+constexpr std::array<size_t, 12> DIGIT_POSITIONS {{
+    1, 2, 8, 9, 10, 11, 13, 14, 16, 17, 19, 20
+}};
+
+// the sum of the 2nd and 3rd letters, mod 32, is unique per month
+constexpr size_t month_slot(char second, char third) noexcept {
+    return (static_cast<unsigned char>(second) +
+            static_cast<unsigned char>(third)) & 31U;
+}
+
+// slot -> month number (1-12), 0 for slots no month hashes to
+constexpr auto MONTH_TABLE { [] {
+    std::array<uint8_t, 32> table {};
+    for (size_t i = 0; i < MONTH_NAMES.size(); ++i)
+        table[month_slot(MONTH_NAMES[i][1], MONTH_NAMES[i][2])] =
+            static_cast<uint8_t>(i + 1);
+    return table;
+}() };
+
+static_assert(std::count_if(MONTH_TABLE.begin(), MONTH_TABLE.end(),
+                            [](uint8_t m) { return m != 0; }) == 12,
+              "month name hash has collisions");
+
+constexpr bool is_digit(char c) noexcept {
+    return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+constexpr int32_t two_digits(const char* in) noexcept {
+    return (in[0] - '0') * 10 + (in[1] - '0');
+}
+
+// days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+// days_from_civil)
+constexpr int64_t days_from_civil(int32_t y, int32_t m, int32_t d) noexcept {
+    y -= m <= 2;
+    const int32_t era { (y >= 0 ? y : y - 399) / 400 };
+    const int32_t yoe { y - era * 400 };
+    const int32_t doy { (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1 };
+    const int32_t doe { yoe * 365 + yoe / 4 - yoe / 100 + doy };
+    return static_cast<int64_t>(era) * 146097 + doe - 719468;
+}
+
+static_assert(days_from_civil(1970, 1, 1) == 0);
+static_assert(days_from_civil(2021, 3, 14) == 18700);
+
+} // namespace
+
+void fix_whole_date(std::string_view adate, IsoDate& out) noexcept {
+    // strptime needs a terminated string; the field is short, so copy
+    // it to the stack rather than the heap
+    char cdate[32] {0};
+    adate.copy(cdate, std::min(adate.size(), sizeof(cdate) - 1));
+    struct tm tm{};
+    strptime(cdate, "[%d/%b/%Y:%T", &tm);
+    char datestring[20] {0};
+    strftime(datestring, 20, "%F %T", &tm);
+    std::copy_n(datestring, out.size(), out.begin());
+}
+
+int32_t raw_day(std::string_view adate) noexcept {
+    // [dd/Mon/yyyy
+    // 012345678901
+    if (adate.size() < 12)
+        return 0;
+    const char* in { adate.data() };
+    const auto month { MONTH_TABLE[month_slot(in[5], in[6])] };
+    bool ok { month != 0 };
+    for (const auto i : {1, 2, 8, 9, 10, 11})
+        ok &= is_digit(in[i]);
+    ok &= (in[0] == '[') & (in[3] == '/') & (in[7] == '/');
+    if (!ok || memcmp(in + 4, MONTH_NAMES[month - 1].data(), 3) != 0)
+        return 0;
+    return (two_digits(in + 8) * 100 + two_digits(in + 10)) * 10000
+           + month * 100 + two_digits(in + 1);
+}
+
+// [dd/Mon/yyyy:hh:mm:ss
+// 012345678901234567890
+bool TimestampConverter::convert_fixed(const char* in, IsoDate& out) const noexcept {
+    const auto month { MONTH_TABLE[month_slot(in[5], in[6])] };
+
+    // accumulate every check and test once at the end
+    bool ok { month != 0 };
+    for (const auto i : DIGIT_POSITIONS)
+        ok &= is_digit(in[i]);
+    ok &= (in[0] == '[') & (in[3] == '/') & (in[7] == '/') &
+          (in[12] == ':') & (in[15] == ':') & (in[18] == ':');
+    if (!ok || memcmp(in + 4, MONTH_NAMES[month - 1].data(), 3) != 0)
+        return false;
+
+    memcpy(out.data(), in + 8, 4);
+    out[4]  = '-';
+    out[5]  = static_cast<char>('0' + month / 10);
+    out[6]  = static_cast<char>('0' + month % 10);
+    out[7]  = '-';
+    out[8]  = in[1];
+    out[9]  = in[2];
+    out[10] = ' ';
+    memcpy(out.data() + 11, in + 13, 8);
+    return true;
+}
+
+int32_t TimestampConverter::offset_seconds(std::string_view aoffset) noexcept {
+    // "-0400]"
+    if (aoffset.size() < 5)
+        return 0;
+    if (memcmp(aoffset.data(), last_offset_in_.data(), 5) == 0)
+        return last_offset_;
+    const char* in { aoffset.data() };
+    if ((in[0] != '-' && in[0] != '+') || !is_digit(in[1]) ||
+        !is_digit(in[2]) || !is_digit(in[3]) || !is_digit(in[4]))
+        return 0;
+    const int32_t secs { two_digits(in + 1) * 3600 + two_digits(in + 3) * 60 };
+    memcpy(last_offset_in_.data(), in, 5);
+    last_offset_ = in[0] == '-' ? -secs : secs;
+    return last_offset_;
+}
+
+int64_t TimestampConverter::local_seconds(const IsoDate& iso) noexcept {
+    // yyyy-mm-dd hh:mm:ss
+    // 0123456789012345678
+    if (memcmp(iso.data(), last_day_.data(), 10) != 0) {
+        const auto year { two_digits(iso.data()) * 100 + two_digits(iso.data() + 2) };
+        last_day_start_ = days_from_civil(year, two_digits(iso.data() + 5),
+                                          two_digits(iso.data() + 8)) * 86400;
+        memcpy(last_day_.data(), iso.data(), 10);
+    }
+    return last_day_start_ + two_digits(iso.data() + 11) * 3600 +
+           two_digits(iso.data() + 14) * 60 + two_digits(iso.data() + 17);
+}
+
+void TimestampConverter::convert(std::string_view adate, std::string_view aoffset,
+                                 IsoDate& out, int64_t& epoch) noexcept {
+    const bool fixed      { adate.size() == RAW_DATE_LEN };
+    const auto utc_offset { offset_seconds(aoffset) };
+    if (fixed && utc_offset == last_in_offset_ &&
+        memcmp(adate.data(), last_in_.data(), RAW_DATE_LEN) == 0) {
+        out   = last_out_;
+        epoch = last_epoch_;
+        return;
+    }
+    if (!fixed || !convert_fixed(adate.data(), out)) {
+        fix_whole_date(adate, out);
+        epoch = local_seconds(out) - utc_offset;
+        return;
+    }
+    epoch = local_seconds(out) - utc_offset;
+    memcpy(last_in_.data(), adate.data(), RAW_DATE_LEN);
+    last_in_offset_ = utc_offset;
+    last_out_       = out;
+    last_epoch_     = epoch;
+}
@@ -0,0 +1,277 @@
+#include "tokenize.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using field_lexer = size_t (*)(std::string_view, std::string_view*, size_t);
+
+// collects fields as the lexers find the spaces between them
+struct FieldSink {
+    const char* line   {nullptr};
+    std::string_view* out {nullptr};
+    size_t max         {0};
+    size_t found       {0};
+    size_t start       {0};
+
+    // the field ending at `pos`; false once there are `max` of them
+    bool add(size_t pos) noexcept {
+        std::string_view field {line + start, pos - start};
+        if (field.size() >= 2 && field.front() == '"' && field.back() == '"')
+            field = field.substr(1, field.size() - 2);
+        out[found++] = field;
+        start = pos + 1;
+        return found < max;
+    }
+};
+
+// from `from` on, one character at a time; `quoted` is whether `from`
+// is inside quotes
+size_t lex_scalar(std::string_view line, size_t from, bool quoted,
+                  FieldSink& fields) noexcept {
+    for (size_t i = from; i < line.size(); ++i) {
+        const char c { line[i] };
+        if (quoted) {
+            if (c == '\\')
+                ++i;
+            else if (c == '"')
+                quoted = false;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ' ' && !fields.add(i)) {
+            return fields.found;
+        }
+    }
+    fields.add(line.size());
+    return fields.found;
+}
+
+#if defined(__x86_64__)
+
+// bit i of the result is the XOR of bits 0..i of `x`: with x a mask of
+// quotes, the bits inside (and on the opening) quotes
+uint32_t prefix_xor(uint32_t x) noexcept {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    return x;
+}
+
+// handles one block of `WIDTH` bytes at `base`, given its space, quote
+// and backslash masks; false once the line is done (every field found,
+// or a backslash that needs the scalar loop); forced inline, as it runs
+// once per block and GCC leaves it out of line otherwise
+template <unsigned WIDTH>
+__attribute__((always_inline)) inline
+bool lex_block(uint32_t spaces, uint32_t quotes, uint32_t backslashes,
+               size_t base, uint32_t& quoted, FieldSink& fields) noexcept {
+    if (backslashes != 0)
+        return false;
+    const uint32_t inside { prefix_xor(quotes) ^ quoted };
+    // carry "still inside quotes" over to the next block
+    quoted = (inside >> (WIDTH - 1)) & 1 ? ~0u : 0u;
+    uint32_t delims { spaces & ~inside };
+    while (delims != 0) {
+        if (!fields.add(base + static_cast<size_t>(__builtin_ctz(delims))))
+            return false;
+        delims &= delims - 1;
+    }
+    return true;
+}
+
+// after lex_block gave up on the block at `base`: done if every field
+// was found, otherwise it hit a backslash, so the scalar loop redoes the
+// block (and the rest of the line)
+size_t finish_lex(std::string_view line, size_t base, uint32_t quoted,
+                  FieldSink& fields) noexcept {
+    if (fields.found == fields.max)
+        return fields.found;
+    return lex_scalar(line, base, quoted != 0, fields);
+}
+
+size_t lex_fields_sse2(std::string_view line, std::string_view* out,
+                       size_t max) noexcept {
+    if (max == 0)
+        return 0;
+    FieldSink fields {line.data(), out, max};
+    const __m128i space     { _mm_set1_epi8(' ') };
+    const __m128i quote     { _mm_set1_epi8('"') };
+    const __m128i backslash { _mm_set1_epi8('\\') };
+    uint32_t quoted {0};
+    size_t i        {0};
+    for (; i + 16 <= line.size(); i += 16) {
+        const __m128i chunk { _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(line.data() + i)) };
+        const auto mask = [&](__m128i c) {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, c)));
+        };
+        if (!lex_block<16>(mask(space), mask(quote), mask(backslash), i,
+                           quoted, fields))
+            return finish_lex(line, i, quoted, fields);
+    }
+    if (i < line.size()) {
+        // the tail, as a whole block rather than one character at a time:
+        // the last 16 bytes of the line with the ones already seen shifted
+        // out of the masks, or a zero-padded copy of a shorter line
+        const auto rest { static_cast<unsigned>(line.size() - i) };
+        char padded[16] {};
+        const char* tail { line.data() + line.size() - 16 };
+        unsigned shift   { 16 - rest };
+        if (line.size() < 16) {
+            memcpy(padded, line.data(), line.size());
+            tail  = padded;
+            shift = 0;
+        }
+        const __m128i chunk { _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)) };
+        const auto mask = [&](__m128i c) {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, c))) >> shift;
+        };
+        if (!lex_block<16>(mask(space), mask(quote), mask(backslash), i,
+                           quoted, fields))
+            return finish_lex(line, i, quoted, fields);
+    }
+    fields.add(line.size());
+    return fields.found;
+}
+
+__attribute__((target("avx2")))
+size_t lex_fields_avx2(std::string_view line, std::string_view* out,
+                       size_t max) noexcept {
+    if (max == 0)
+        return 0;
+    FieldSink fields {line.data(), out, max};
+    const __m256i space     { _mm256_set1_epi8(' ') };
+    const __m256i quote     { _mm256_set1_epi8('"') };
+    const __m256i backslash { _mm256_set1_epi8('\\') };
+    uint32_t quoted {0};
+    size_t i        {0};
+    for (; i + 32 <= line.size(); i += 32) {
+        const __m256i chunk { _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(line.data() + i)) };
+        const auto mask = [&](__m256i c) __attribute__((target("avx2"))) {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, c)));
+        };
+        if (!lex_block<32>(mask(space), mask(quote), mask(backslash), i,
+                           quoted, fields))
+            return finish_lex(line, i, quoted, fields);
+    }
+    if (i < line.size()) {
+        const auto rest { static_cast<unsigned>(line.size() - i) };
+        char padded[32] {};
+        const char* tail { line.data() + line.size() - 32 };
+        unsigned shift   { 32 - rest };
+        if (line.size() < 32) {
+            memcpy(padded, line.data(), line.size());
+            tail  = padded;
+            shift = 0;
+        }
+        const __m256i chunk { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail)) };
+        const auto mask = [&](__m256i c) __attribute__((target("avx2"))) {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, c))) >> shift;
+        };
+        if (!lex_block<32>(mask(space), mask(quote), mask(backslash), i,
+                           quoted, fields))
+            return finish_lex(line, i, quoted, fields);
+    }
+    fields.add(line.size());
+    return fields.found;
+}
+
+field_lexer pick_field_lexer() noexcept {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return lex_fields_avx2;
+    return lex_fields_sse2;
+}
+
+#else
+
+size_t lex_fields_scalar(std::string_view line, std::string_view* out,
+                         size_t max) noexcept {
+    if (max == 0)
+        return 0;
+    FieldSink fields {line.data(), out, max};
+    return lex_scalar(line, 0, false, fields);
+}
+
+field_lexer pick_field_lexer() noexcept {
+    return lex_fields_scalar;
+}
+
+#endif
+
+} // namespace
+
+size_t lex_fields(std::string_view line, std::string_view* out, size_t max) noexcept {
+    static const field_lexer impl { pick_field_lexer() };
+    return impl(line, out, max);
+}
+
+std::string_view request_url(std::string_view request) noexcept {
+    const auto first { request.find(' ') };
+    if (first == std::string_view::npos)
+        return {};
+    request.remove_prefix(first + 1);
+    return request.substr(0, request.find(' '));
+}
+
+namespace {
+
+constexpr uint64_t ASCII_ZEROS {0x3030303030303030};
+constexpr size_t MAX_DIGITS    {16};
+
+// the 8 bytes ending at `end`, with all but the last `digits` (the ones
+// before the field) replaced by '0's
+uint64_t load_digits(const char* end, size_t digits) noexcept {
+    uint64_t word {0};
+    memcpy(&word, end - 8, 8);
+    // little-endian, so the bytes before the field are the low ones; the
+    // shift is split in two so that 8 digits shifts by 64 without UB
+    const uint64_t before { (~0ULL >> (4 * digits)) >> (4 * digits) };
+    return (word & ~before) | (ASCII_ZEROS & before);
+}
+
+// whether all 8 bytes of `word` are '0' to '9'
+bool all_digits(uint64_t word) noexcept {
+    constexpr uint64_t HIGH_NIBBLES {0xF0F0F0F0F0F0F0F0};
+    return ((word & HIGH_NIBBLES)
+            | (((word + 0x0606060606060606) & HIGH_NIBBLES) >> 4)) == 0x3333333333333333;
+}
+
+// the 8 digits in `word` (most significant in the lowest byte) as a
+// number, combining pairs of digits, then of pairs, then of quads
+uint64_t digits_value(uint64_t word) noexcept {
+    word -= ASCII_ZEROS;
+    word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FF;
+    word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFF;
+    return (word * 10000 + (word >> 32)) & 0xFFFFFFFF;
+}
+
+} // namespace
+
+uint64_t parse_decimal(std::string_view line, std::string_view field) noexcept {
+    const auto digits { field.size() };
+    if (digits == 0 || digits > MAX_DIGITS)
+        return 0;
+    const char* end { field.data() + digits };
+    if (static_cast<size_t>(end - line.data()) < MAX_DIGITS) {
+        uint64_t value {0};
+        for (const char c : field) {
+            if (c < '0' || c > '9')
+                return 0;
+            value = value * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return value;
+    }
+    const auto low  { load_digits(end, digits < 8 ? digits : 8) };
+    const auto high { load_digits(end - 8, digits > 8 ? digits - 8 : 0) };
+    const auto valid { static_cast<uint64_t>(all_digits(low) & all_digits(high)) };
+    return (digits_value(high) * 100000000 + digits_value(low)) & (0 - valid);
+}
@@ -0,0 +1,103 @@
+#include "traffic_stats.h"
+
+#include <algorithm>
+
+#include <fmt/core.h>
+
+#include "output.h"
+
+namespace {
+
+constexpr size_t INITIAL_SLOTS {4096};
+
+// Fibonacci hashing; keys are small and sequential in both halves
+uint32_t hash_key(uint64_t key) noexcept {
+    return static_cast<uint32_t>((key * 0x9E3779B97F4A7C15) >> 32);
+}
+
+} // namespace
+
+TrafficStats::TrafficStats(HostTable& hosts) : hosts_ {&hosts} {
+    slots_.resize(INITIAL_SLOTS);
+}
+
+uint32_t TrafficStats::day_index(const LogRecord& rec) {
+    const auto day { rec.date_view().substr(0, 10) };
+    if (!days_.empty() && days_[day_] == day)
+        return day_;
+    // the days seen so far are few, and each is only looked up again
+    // after a midnight (or when nodes' logs straddle one)
+    const auto found { std::find(days_.begin(), days_.end(), day) };
+    if (found == days_.end()) {
+        day_ = static_cast<uint32_t>(days_.size());
+        days_.emplace_back(day);
+    } else {
+        day_ = static_cast<uint32_t>(found - days_.begin());
+    }
+    return day_;
+}
+
+TrafficStats::Entry& TrafficStats::entry(uint64_t key) {
+    const auto mask { slots_.size() - 1 };
+    for (auto i = hash_key(key) & mask; ; i = (i + 1) & mask) {
+        auto& slot { slots_[i] };
+        if (slot == 0) {
+            entries_.push_back({key, 0, 0, {}});
+            slot = static_cast<uint32_t>(entries_.size());
+            // keep the table at most half full
+            if (entries_.size() * 2 > slots_.size())
+                grow();
+            return entries_.back();
+        }
+        if (entries_[slot - 1].key == key)
+            return entries_[slot - 1];
+    }
+}
+
+void TrafficStats::grow() {
+    std::vector<uint32_t> old (slots_.size() * 2);
+    old.swap(slots_);
+    const auto mask { slots_.size() - 1 };
+    for (const auto slot : old) {
+        if (slot == 0)
+            continue;
+        auto i { hash_key(entries_[slot - 1].key) & mask };
+        while (slots_[i] != 0)
+            i = (i + 1) & mask;
+        slots_[i] = slot;
+    }
+}
+
+void TrafficStats::add(const LogRecord& rec) {
+    const uint64_t key { static_cast<uint64_t>(day_index(rec)) << 32
+                         | hosts_->intern(rec.url) };
+    auto& totals { entry(key) };
+    ++totals.requests;
+    totals.bytes += rec.bytes;
+    // 1xx to 5xx are 0 to 4, and everything else (0 included) is 5
+    const unsigned status_class { rec.status / 100U - 1 };
+    ++totals.statuses[status_class < STATUS_CLASSES - 1 ? status_class
+                                                        : STATUS_CLASSES - 1];
+}
+
+void TrafficStats::write(FILE* out) const {
+    std::vector<const Entry*> sorted {};
+    sorted.reserve(entries_.size());
+    for (const auto& totals : entries_)
+        sorted.push_back(&totals);
+    const auto day  = [&](const Entry* e) -> const std::string& { return days_[e->key >> 32]; };
+    const auto host = [&](const Entry* e) { return hosts_->host(static_cast<uint32_t>(e->key)); };
+    std::sort(sorted.begin(), sorted.end(), [&](const Entry* a, const Entry* b) {
+        if (day(a) != day(b))
+            return day(a) < day(b);
+        return host(a) < host(b);
+    });
+
+    fmt::print(out, "date\turl\trequests\tbytes\t1xx\t2xx\t3xx\t4xx\t5xx\tother\n");
+    for (const auto* totals : sorted) {
+        const auto& s { totals->statuses };
+        fmt::print(out, "{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+                   day(totals), escape_field(host(totals)), totals->requests, totals->bytes,
+                   s[0], s[1], s[2], s[3], s[4], s[5]);
+    }
+}
@@ -0,0 +1,88 @@
+#include "url.h"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr bool is_scheme_char(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.';
+}
+
+constexpr bool is_digit(char c) noexcept {
+    return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+constexpr bool ends_authority(char c) noexcept {
+    return c == '/' || c == '?' || c == '#';
+}
+
+// offset of "//" after "scheme:", or 0 if the URL doesn't start with one
+size_t authority_start(std::string_view url) noexcept {
+    size_t i {0};
+    while (i < url.size() && is_scheme_char(url[i]))
+        ++i;
+    if (i == 0 || url.substr(i, 3) != "://")
+        return 0;
+    return i + 3;
+}
+
+// offset of the first '/', '?' or '#' at or after `from` (or the size)
+size_t authority_end(std::string_view url, size_t from) noexcept {
+    size_t i { from };
+#if defined(__x86_64__)
+    const __m128i slash    { _mm_set1_epi8('/') };
+    const __m128i question { _mm_set1_epi8('?') };
+    const __m128i hash     { _mm_set1_epi8('#') };
+    for (; i + 16 <= url.size(); i += 16) {
+        const __m128i chunk { _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(url.data() + i)) };
+        const __m128i hits { _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, slash),
+                             _mm_cmpeq_epi8(chunk, question)),
+                _mm_cmpeq_epi8(chunk, hash)) };
+        const auto mask { static_cast<unsigned>(_mm_movemask_epi8(hits)) };
+        if (mask != 0)
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+#endif
+    for (; i < url.size(); ++i)
+        if (ends_authority(url[i]))
+            return i;
+    return url.size();
+}
+
+} // namespace
+
+std::string_view get_small_url(std::string_view fullurl) noexcept {
+    const auto start { authority_start(fullurl) };
+    std::string_view host { fullurl.substr(start,
+                                           authority_end(fullurl, start) - start) };
+
+    // user:password@host
+    const auto at { host.rfind('@') };
+    if (at != std::string_view::npos)
+        host.remove_prefix(at + 1);
+
+    if (!host.empty() && host.front() == '[') {
+        // [v6:address]:port
+        const auto close { host.find(']') };
+        return close == std::string_view::npos ? std::string_view{}
+                                                : host.substr(1, close - 1);
+    }
+    const auto colon { host.find(':') };
+    if (colon != std::string_view::npos)
+        host.remove_suffix(host.size() - colon);
+
+    // special case for "58122.on.worldcat.org" (and possibly more)
+    if (!host.empty() && is_digit(host.front())) {
+        const auto dot { host.find('.') };
+        if (dot != std::string_view::npos && dot > 0 && is_digit(host[dot-1]))
+            host.remove_prefix(dot + 1);
+    }
+    return host;
+}